@@ -9,6 +9,11 @@
 #define SWAL_COM_H
 
 #include "win_headers.h"
+#include <concepts>
+#include <cstddef>
+#include <system_error>
+#include <utility>
+#include "error.h"
 
 namespace swal {
 
@@ -28,6 +33,113 @@ struct ComInitializer
     }
 };
 
+template <typename T>
+class com_ptr;
+
+// Non-owning interface pointer for parameters and locals: passing or copying
+// it never touches the reference count. The referenced object must be kept
+// alive by someone else for as long as the com_ref is used.
+template <typename T>
+class com_ref {
+public:
+	com_ref(T* ptr) noexcept : ptr(ptr) {}
+	template <typename U> requires std::convertible_to<U*, T*>
+	com_ref(const com_ptr<U>& other) noexcept : ptr(other.get()) {}
+	template <typename U> requires std::convertible_to<U*, T*>
+	com_ref(com_ref<U> other) noexcept : ptr(other.get()) {}
+	T* get() const noexcept { return ptr; }
+	T* operator ->() const noexcept { return ptr; }
+	T& operator *() const noexcept { return *ptr; }
+	explicit operator bool() const noexcept { return ptr != nullptr; }
+	// Takes a new reference
+	com_ptr<T> clone() const noexcept {
+		if (ptr) {
+			ptr->AddRef();
+		}
+		com_ptr<T> result;
+		result.attach(ptr);
+		return result;
+	}
+	template <typename U>
+	com_ptr<U> QueryInterface() const {
+		com_ptr<U> result;
+		com_call(ptr->QueryInterface(__uuidof(U), result.put_void()));
+		return result;
+	}
+	template <typename U>
+	com_ptr<U> QueryInterface(std::error_code& ec) const noexcept {
+		com_ptr<U> result;
+		auto hr = ptr->QueryInterface(__uuidof(U), result.put_void());
+		ec = FAILED(hr) ? std::error_code(com_errc(hr)) : std::error_code();
+		return result;
+	}
+	friend bool operator ==(com_ref a, com_ref b) noexcept { return a.ptr == b.ptr; }
+private:
+	T* ptr;
+};
+
+// Owning interface pointer. It is move-only, so ownership transfers never
+// AddRef/Release; an extra reference is only taken by an explicit clone().
+template <typename T>
+class com_ptr {
+public:
+	com_ptr() noexcept : ptr(nullptr) {}
+	com_ptr(std::nullptr_t) noexcept : ptr(nullptr) {}
+	~com_ptr() {
+		if (ptr) {
+			ptr->Release();
+		}
+	}
+	com_ptr(com_ptr&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+	template <typename U> requires std::convertible_to<U*, T*>
+	com_ptr(com_ptr<U>&& other) noexcept : ptr(other.detach()) {}
+	com_ptr& operator=(com_ptr&& other) noexcept {
+		std::swap(ptr, other.ptr);
+		return *this;
+	}
+	com_ptr(const com_ptr&) = delete;
+	com_ptr& operator=(const com_ptr&) = delete;
+	T* get() const noexcept { return ptr; }
+	T* operator ->() const noexcept { return ptr; }
+	T& operator *() const noexcept { return *ptr; }
+	explicit operator bool() const noexcept { return ptr != nullptr; }
+	com_ref<T> ref() const noexcept { return ptr; }
+	com_ptr clone() const noexcept { return ref().clone(); }
+	void reset() noexcept {
+		if (auto old = std::exchange(ptr, nullptr)) {
+			old->Release();
+		}
+	}
+	// Takes ownership of an already AddRef'ed pointer
+	void attach(T* other) noexcept {
+		reset();
+		ptr = other;
+	}
+	T* detach() noexcept { return std::exchange(ptr, nullptr); }
+	// Releases the current pointer and returns storage for an out parameter
+	T** put() noexcept {
+		reset();
+		return &ptr;
+	}
+	void** put_void() noexcept { return reinterpret_cast<void**>(put()); }
+	template <typename U>
+	com_ptr<U> QueryInterface() const { return ref().template QueryInterface<U>(); }
+	template <typename U>
+	com_ptr<U> QueryInterface(std::error_code& ec) const noexcept {
+		return ref().template QueryInterface<U>(ec);
+	}
+	friend void swap(com_ptr& a, com_ptr& b) noexcept { std::swap(a.ptr, b.ptr); }
+private:
+	T* ptr;
+};
+
+template <typename T>
+com_ptr<T> CoCreateInstance(REFCLSID clsid, DWORD context = CLSCTX_INPROC_SERVER) {
+	com_ptr<T> result;
+	com_call(::CoCreateInstance(clsid, nullptr, context, __uuidof(T), result.put_void()));
+	return result;
+}
+
 }
 
 #endif /* SWAL_COM_H */
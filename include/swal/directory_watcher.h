@@ -0,0 +1,389 @@
+#ifndef SWAL_DIRECTORY_WATCHER_H
+#define SWAL_DIRECTORY_WATCHER_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "enum_bitwise.h"
+#include "error.h"
+#include "handle.h"
+
+namespace swal {
+
+struct FileNotification {
+	DWORD action;
+	std::wstring_view name;
+};
+
+// Walks the FILE_NOTIFY_INFORMATION records of a ReadDirectoryChangesW
+// buffer in place
+class FileNotifyRange {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = FileNotification;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = FileNotification;
+		iterator() noexcept : pos(nullptr), end(nullptr) {}
+		FileNotification operator*() const
+		{
+			auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pos);
+			return { info->Action, { info->FileName, info->FileNameLength / sizeof(WCHAR) } };
+		}
+		iterator& operator++()
+		{
+			auto next = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pos)->NextEntryOffset;
+			pos = (next != 0 && next < DWORD(end - pos)) ? pos + next : nullptr;
+			Check();
+			return *this;
+		}
+		iterator operator++(int)
+		{
+			auto result = *this;
+			++*this;
+			return result;
+		}
+		friend bool operator==(const iterator& a, const iterator& b) noexcept
+		{
+			return a.pos == b.pos;
+		}
+	private:
+		friend class FileNotifyRange;
+		iterator(const BYTE* pos, const BYTE* end) noexcept : pos(pos), end(end)
+		{
+			Check();
+		}
+		// drops a record that does not fit in the buffer
+		void Check() noexcept
+		{
+			if (pos && (DWORD(end - pos) < offsetof(FILE_NOTIFY_INFORMATION, FileName) ||
+				reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(pos)->FileNameLength >
+					DWORD(end - pos) - offsetof(FILE_NOTIFY_INFORMATION, FileName)))
+			{
+				pos = nullptr;
+			}
+		}
+		const BYTE* pos;
+		const BYTE* end;
+	};
+	FileNotifyRange(const void* buffer, DWORD size) noexcept :
+		first(static_cast<const BYTE*>(buffer)), last(first + size) {}
+	iterator begin() const noexcept { return first != last ? iterator(first, last) : iterator(); }
+	iterator end() const noexcept { return {}; }
+private:
+	const BYTE* first;
+	const BYTE* last;
+};
+
+enum class DirectoryChangeFlags {
+	None = 0,
+	Added = 1,
+	Removed = 2,
+	Modified = 4,
+	RenamedFrom = 8,
+	RenamedTo = 16
+};
+
+template <> struct enable_enum_bitwise<DirectoryChangeFlags> : std::true_type {};
+
+#if _WIN32_WINNT >= 0x0600
+
+// Watches a directory with ReadDirectoryChangesW through an
+// IOCompletionPort. Completion packets for key are passed to
+// HandleCompletion by the caller's threads. Notifications are merged per path
+// and delivered once a path has been quiet for the debounce window, so a
+// burst of writes to one file becomes one change. A notification buffer
+// overflow discards what is pending and calls overflow, after which the
+// caller should rescan. The destructor waits for outstanding packets, so
+// other threads must keep dispatching until it returns.
+class DirectoryWatcher {
+public:
+	using clock = std::chrono::steady_clock;
+	static constexpr DWORD DefaultFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+	struct Change {
+		std::wstring path;
+		DirectoryChangeFlags flags;
+	};
+	struct Callbacks {
+		std::function<void(std::span<const Change>)> changes;
+		std::function<void()> overflow;
+		// watching has stopped, e.g. because the directory was deleted
+		std::function<void(DWORD error)> error;
+	};
+	template <typename T>
+	DirectoryWatcher(const IOCompletionPortHandle<T>& port, ULONG_PTR key, const tstring& path, Callbacks callbacks,
+		DWORD filter = DefaultFilter, bool subtree = true,
+		clock::duration debounce = std::chrono::milliseconds(50), DWORD bufferSize = 64 * 1024) :
+		dir(path, FILE_LIST_DIRECTORY, ShareMode::Read | ShareMode::Write | ShareMode::Delete,
+			CreateMode::OpenExisting, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED),
+		port(static_cast<const T&>(port)),
+		key(key),
+		callbacks(std::move(callbacks)),
+		filter(filter),
+		subtree(subtree),
+		debounce(debounce),
+		buffers{ std::vector<DWORD>(bufferSize / sizeof(DWORD)), std::vector<DWORD>(bufferSize / sizeof(DWORD)) },
+		timer(winapi_call(CreateThreadpoolTimer(OnTimer, this, nullptr)))
+	{
+		try {
+			port.AssocFile(dir, key);
+			if (!Read(0)) {
+				throw std::system_error(win32_errc(GetLastError()));
+			}
+		} catch (...) {
+			CloseThreadpoolTimer(timer);
+			throw;
+		}
+	}
+	~DirectoryWatcher() {
+		Stop();
+		{
+			std::unique_lock lock(mutex);
+			drained.wait(lock, [this]{ return outstanding == 0; });
+		}
+		CloseThreadpoolTimer(timer);
+	}
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+	// Returns false if the packet does not belong to this watcher
+	bool HandleCompletion(const CompletionStatusResult& status) {
+		if (status.key != key || (status.ovl != &readOvl[0] && status.ovl != &readOvl[1] && status.ovl != &flushOvl)) {
+			return false;
+		}
+		if (status.ovl == &flushOvl) {
+			Flush();
+		} else {
+			OnRead(status.ovl == &readOvl[0] ? 0 : 1, status.error, status.bytesTransfered);
+		}
+		Release();
+		return true;
+	}
+	// Delivers everything pending now, regardless of the debounce window
+	void FlushAll() {
+		Deliver(clock::time_point::max());
+	}
+	void Stop() {
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+			::CancelIoEx(dir, nullptr);
+		}
+		SetThreadpoolTimer(timer, nullptr, 0, 0);
+		WaitForThreadpoolTimerCallbacks(timer, TRUE);
+	}
+private:
+	struct Pending {
+		DirectoryChangeFlags flags;
+		clock::time_point deadline;
+	};
+	struct PathHash {
+		using is_transparent = void;
+		std::size_t operator()(std::wstring_view path) const noexcept {
+			return std::hash<std::wstring_view>()(path);
+		}
+	};
+	static DirectoryChangeFlags ToFlags(DWORD action) {
+		switch (action) {
+		case FILE_ACTION_ADDED: return DirectoryChangeFlags::Added;
+		case FILE_ACTION_REMOVED: return DirectoryChangeFlags::Removed;
+		case FILE_ACTION_MODIFIED: return DirectoryChangeFlags::Modified;
+		case FILE_ACTION_RENAMED_OLD_NAME: return DirectoryChangeFlags::RenamedFrom;
+		case FILE_ACTION_RENAMED_NEW_NAME: return DirectoryChangeFlags::RenamedTo;
+		default: return DirectoryChangeFlags::None;
+		}
+	}
+	// Reads into buffers[index] with readOvl[index], so a completion names
+	// its buffer. The mutex is held while issuing so that Stop cannot miss
+	// the read; a buffer still being parsed is read into once Parsed
+	// releases it.
+	bool Read(unsigned index) {
+		std::lock_guard lock(mutex);
+		if (stopping) {
+			return true;
+		}
+		if (parsing[index]) {
+			deferred = true;
+			return true;
+		}
+		return Issue(index);
+	}
+	// called with the mutex held
+	bool Issue(unsigned index) {
+		auto& buffer = buffers[index];
+		readOvl[index] = {};
+		if (!::ReadDirectoryChangesW(dir, buffer.data(), DWORD(buffer.size() * sizeof(DWORD)), subtree, filter, nullptr, &readOvl[index], nullptr)) {
+			return false;
+		}
+		++outstanding;
+		return true;
+	}
+	// Returns false with the error in last error if a deferred read failed
+	bool Parsed(unsigned index) {
+		std::lock_guard lock(mutex);
+		parsing[index] = false;
+		if (!deferred) {
+			return true;
+		}
+		deferred = false;
+		return stopping || Issue(index);
+	}
+	void OnRead(unsigned index, DWORD error, DWORD transferred) {
+		if (error == ERROR_SUCCESS && transferred != 0) {
+			// parse one buffer while the kernel fills the other
+			{
+				std::lock_guard lock(mutex);
+				parsing[index] = true;
+			}
+			bool reading = Read(index ^ 1);
+			auto err = GetLastError();
+			Merge(FileNotifyRange(buffers[index].data(), transferred));
+			if (!Parsed(index)) {
+				reading = false;
+				err = GetLastError();
+			}
+			if (!reading && callbacks.error) {
+				callbacks.error(err);
+			}
+			return;
+		}
+		if (error == ERROR_SUCCESS || error == ERROR_NOTIFY_ENUM_DIR) {
+			{
+				std::lock_guard lock(mutex);
+				pending.clear();
+			}
+			bool reading = Read(index ^ 1);
+			auto err = GetLastError();
+			if (callbacks.overflow) {
+				callbacks.overflow();
+			}
+			if (!reading && callbacks.error) {
+				callbacks.error(err);
+			}
+			return;
+		}
+		bool stopped;
+		{
+			std::lock_guard lock(mutex);
+			stopped = stopping;
+		}
+		if (!(stopped && error == ERROR_OPERATION_ABORTED) && callbacks.error) {
+			callbacks.error(error);
+		}
+	}
+	void Merge(FileNotifyRange notifications) {
+		auto deadline = clock::now() + debounce;
+		std::lock_guard lock(mutex);
+		for (auto notification : notifications) {
+			auto it = pending.find(notification.name);
+			if (it == pending.end()) {
+				it = pending.emplace(std::wstring(notification.name), Pending{ DirectoryChangeFlags::None, deadline }).first;
+			}
+			it->second.flags |= ToFlags(notification.action);
+			it->second.deadline = deadline;
+		}
+		if (!armed && !pending.empty()) {
+			Arm(deadline);
+		}
+	}
+	void Flush() {
+		{
+			std::lock_guard lock(mutex);
+			armed = false;
+		}
+		Deliver(clock::now());
+	}
+	void Deliver(clock::time_point now) {
+		std::vector<Change> due;
+		{
+			std::lock_guard lock(mutex);
+			auto next = clock::time_point::max();
+			for (auto it = pending.begin(); it != pending.end();) {
+				if (it->second.deadline <= now) {
+					auto node = pending.extract(it++);
+					due.push_back({ std::move(node.key()), node.mapped().flags });
+				} else {
+					next = std::min(next, it->second.deadline);
+					++it;
+				}
+			}
+			if (!armed && next != clock::time_point::max()) {
+				Arm(next);
+			}
+		}
+		if (!due.empty() && callbacks.changes) {
+			callbacks.changes(due);
+		}
+	}
+	// called with the mutex held
+	void Arm(clock::time_point deadline) {
+		if (stopping) {
+			return;
+		}
+		auto delay = std::max(deadline - clock::now(), clock::duration::zero());
+		ULARGE_INTEGER due;
+		due.QuadPart = ULONGLONG(-LONGLONG(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count() / 100));
+		FILETIME ft;
+		ft.dwLowDateTime = due.LowPart;
+		ft.dwHighDateTime = due.HighPart;
+		armed = true;
+		SetThreadpoolTimer(timer, &ft, 0, 0);
+	}
+	static void CALLBACK OnTimer(PTP_CALLBACK_INSTANCE, PVOID context, PTP_TIMER) {
+		auto& self = *static_cast<DirectoryWatcher*>(context);
+		{
+			std::lock_guard lock(self.mutex);
+			if (self.stopping) {
+				return;
+			}
+			++self.outstanding;
+		}
+		self.flushOvl = {};
+		if (!::PostQueuedCompletionStatus(self.port, 0, self.key, &self.flushOvl)) {
+			self.Release();
+		}
+	}
+	void Release() {
+		std::lock_guard lock(mutex);
+		if (--outstanding == 0) {
+			drained.notify_all();
+		}
+	}
+	File dir;
+	HANDLE port;
+	ULONG_PTR key;
+	Callbacks callbacks;
+	DWORD filter;
+	bool subtree;
+	clock::duration debounce;
+	std::vector<DWORD> buffers[2];
+	OVERLAPPED readOvl[2] = {};
+	OVERLAPPED flushOvl = {};
+	PTP_TIMER timer;
+	std::mutex mutex;
+	std::condition_variable drained;
+	std::unordered_map<std::wstring, Pending, PathHash, std::equal_to<>> pending;
+	unsigned outstanding = 0;
+	bool parsing[2] = {};
+	bool deferred = false;
+	bool armed = false;
+	bool stopping = false;
+};
+
+#endif
+
+}
+
+#endif // SWAL_DIRECTORY_WATCHER_H
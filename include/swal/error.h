@@ -73,6 +73,20 @@ inline std::error_code make_error_code(com_errc err) {
 	return { int(HRESULT(err)), com_category::instance() };
 }
 
+// Thrown for ERROR_OPERATION_ABORTED, so that cancelled I/O can be told apart
+// from real failures while still being caught as a std::system_error
+class operation_aborted : public std::system_error {
+public:
+	operation_aborted() : std::system_error(win32_errc(ERROR_OPERATION_ABORTED)) {}
+};
+
+[[noreturn]] inline void throw_win32_error(DWORD err) {
+	if (err == ERROR_OPERATION_ABORTED) {
+		throw operation_aborted();
+	}
+	throw std::system_error(win32_errc(err));
+}
+
 template <typename T>
 T winapi_call(T result) {
 	if (result) {
@@ -82,14 +96,14 @@ T winapi_call(T result) {
     if (err == ERROR_SUCCESS) {
         return result;
     }
-    throw std::system_error(win32_errc(err));
+    throw_win32_error(err);
 }
 
 template <typename T, typename F>
 auto winapi_call(T result, DWORD(*chk)(F)) -> typename std::remove_reference<F>::type {
 	DWORD err = chk(result);
 	if (err != ERROR_SUCCESS) {
-		throw std::system_error(win32_errc(err));
+		throw_win32_error(err);
 	}
 	return result;
 }
@@ -98,7 +112,7 @@ template <typename T, typename F>
 T winapi_call(T result, const F& chk) {
 	DWORD err = chk(result);
 	if (err != ERROR_SUCCESS) {
-		throw std::system_error(win32_errc(err));
+		throw_win32_error(err);
 	}
 	return result;
 }
@@ -145,6 +159,14 @@ inline DWORD OverlappedFile_error_check(BOOL& result) {
     return e;
 }
 
+inline DWORD ConnectNamedPipe_error_check(BOOL result) {
+	DWORD e;
+	if (result || (e = GetLastError()) == ERROR_PIPE_CONNECTED) {
+		return ERROR_SUCCESS;
+	}
+	return e;
+}
+
 inline DWORD CancelIoEx_error_check(BOOL result) {
 	if (!result) {
 		auto err = GetLastError();
@@ -163,9 +185,9 @@ inline DWORD CreateFile_error_check(HANDLE result) {
 }
 
 inline DWORD GetDIBits_error_check(int result) {
-	if (result == 0) throw 0;
-	if (result == ERROR_INVALID_PARAMETER) {
-		return result;
+	if (result == 0) {
+		auto err = GetLastError();
+		return (err != ERROR_SUCCESS ? err : ERROR_INVALID_PARAMETER);
 	}
 	return ERROR_SUCCESS;
 }
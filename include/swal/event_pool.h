@@ -0,0 +1,114 @@
+#ifndef SWAL_EVENT_POOL_H
+#define SWAL_EVENT_POOL_H
+
+#include "win_headers.h"
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "handle.h"
+
+namespace swal {
+
+// Recycles Event objects instead of paying CreateEvent + CloseHandle per
+// operation. Leases hand out non-signalled events and give them back on
+// destruction; up to capacity idle events of each kind are kept. The pool
+// must outlive its leases.
+class EventPool {
+public:
+	class Lease {
+	public:
+		Lease() noexcept : pool(nullptr), manualReset(false) {}
+		~Lease() {
+			if (pool) {
+				pool->Return(std::move(event), manualReset);
+			}
+		}
+		Lease(Lease&& other) noexcept :
+			pool(std::exchange(other.pool, nullptr)),
+			event(std::move(other.event)),
+			manualReset(other.manualReset)
+		{}
+		Lease& operator=(Lease&& other) noexcept {
+			std::swap(pool, other.pool);
+			std::swap(event, other.event);
+			std::swap(manualReset, other.manualReset);
+			return *this;
+		}
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		const Event& Get() const { return event; }
+		operator const Event&() const { return event; }
+		operator HANDLE() const { return event; }
+		const Event* operator ->() const { return &event; }
+		bool IsManualReset() const { return manualReset; }
+	private:
+		Lease(EventPool* pool, Event event, bool manualReset) :
+			pool(pool), event(std::move(event)), manualReset(manualReset) {}
+		EventPool* pool;
+		Event event;
+		bool manualReset;
+		friend class EventPool;
+	};
+	explicit EventPool(std::size_t capacity = 64) : capacity(capacity) {}
+	EventPool(const EventPool&) = delete;
+	EventPool& operator=(const EventPool&) = delete;
+	Lease Acquire(bool manualReset = true) {
+		{
+			std::lock_guard lock(mutex);
+			auto& idle = Idle(manualReset);
+			if (!idle.empty()) {
+				Event event = std::move(idle.back());
+				idle.pop_back();
+				return { this, std::move(event), manualReset };
+			}
+		}
+		return { this, Event(manualReset, false), manualReset };
+	}
+	void SetCapacity(std::size_t capacity) {
+		std::vector<Event> dropped;
+		std::lock_guard lock(mutex);
+		this->capacity = capacity;
+		for (auto idle : { &idleManual, &idleAuto }) {
+			while (idle->size() > capacity) {
+				dropped.push_back(std::move(idle->back()));
+				idle->pop_back();
+			}
+		}
+	}
+	std::size_t IdleCount() const {
+		std::lock_guard lock(mutex);
+		return idleManual.size() + idleAuto.size();
+	}
+	void Clear() {
+		std::vector<Event> manual, automatic;
+		std::lock_guard lock(mutex);
+		manual.swap(idleManual);
+		automatic.swap(idleAuto);
+	}
+private:
+	std::vector<Event>& Idle(bool manualReset) {
+		return manualReset ? idleManual : idleAuto;
+	}
+	void Return(Event event, bool manualReset) noexcept {
+		if (!::ResetEvent(event)) {
+			return;
+		}
+		std::lock_guard lock(mutex);
+		auto& idle = Idle(manualReset);
+		if (idle.size() < capacity) {
+			try {
+				idle.push_back(std::move(event));
+			} catch (...) {
+			}
+		}
+	}
+	mutable std::mutex mutex;
+	std::size_t capacity;
+	std::vector<Event> idleManual;
+	std::vector<Event> idleAuto;
+};
+
+}
+
+#endif // SWAL_EVENT_POOL_H
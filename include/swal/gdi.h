@@ -9,9 +9,13 @@
 #define SWAL_GDI_H
 
 #include "win_headers.h"
+#include <algorithm>
+#include <span>
+#include <vector>
 #include "error.h"
 #include "zero_or_resource.h"
 #include "enum_bitwise.h"
+#include "pixels.h"
 
 namespace swal {
 
@@ -53,6 +57,100 @@ public:
 		Pen(PenStyle::Solid, 1, color) {}
 };
 
+enum class HatchStyle {
+	Horizontal = HS_HORIZONTAL,
+	Vertical = HS_VERTICAL,
+	FDiagonal = HS_FDIAGONAL,
+	BDiagonal = HS_BDIAGONAL,
+	Cross = HS_CROSS,
+	DiagCross = HS_DIAGCROSS
+};
+
+class Brush : public GdiObj {
+public:
+	Brush(COLORREF color) :
+		GdiObj(winapi_call(CreateSolidBrush(color))) {}
+	Brush(HatchStyle hatch, COLORREF color) :
+		GdiObj(winapi_call(CreateHatchBrush(static_cast<int>(hatch), color))) {}
+};
+
+class Bitmap : public GdiObj {
+public:
+	Bitmap() noexcept : GdiObj(NULL) {}
+	explicit Bitmap(HBITMAP bitmap) noexcept : GdiObj(bitmap) {}
+	Bitmap(HDC hdc, int width, int height) :
+		GdiObj(winapi_call(CreateCompatibleBitmap(hdc, width, height))) {}
+};
+
+class DibSection : public Bitmap {
+public:
+	DibSection() noexcept : Bitmap() {}
+	DibSection(HDC hdc, int width, int height) :
+		DibSection(Create(hdc, width, height), width, height) {}
+	DibSection(int width, int height) : DibSection(NULL, width, height) {}
+	DibSection(const DibSection&) = delete;
+	DibSection& operator=(const DibSection&) = delete;
+	DibSection(DibSection&& other) noexcept :
+		Bitmap(std::move(other)),
+		bits(std::exchange(other.bits, nullptr)),
+		width(std::exchange(other.width, 0)),
+		height(std::exchange(other.height, 0))
+	{}
+	DibSection& operator=(DibSection&& other) noexcept {
+		Bitmap::operator=(std::move(other));
+		std::swap(bits, other.bits);
+		std::swap(width, other.width);
+		std::swap(height, other.height);
+		return *this;
+	}
+	int Width() const { return width; }
+	int Height() const { return height; }
+	pixel_view Pixels() {
+		GdiFlush();
+		return { bits, std::size_t(width), std::size_t(height) };
+	}
+	const_pixel_view Pixels() const {
+		GdiFlush();
+		return { bits, std::size_t(width), std::size_t(height) };
+	}
+	std::span<std::uint32_t> Span() {
+		GdiFlush();
+		return { bits, std::size_t(width) * std::size_t(height) };
+	}
+	std::span<const std::uint32_t> Span() const {
+		GdiFlush();
+		return { bits, std::size_t(width) * std::size_t(height) };
+	}
+	std::span<std::uint32_t> Row(int y) { return Pixels().row(std::size_t(y)); }
+	std::span<const std::uint32_t> Row(int y) const { return Pixels().row(std::size_t(y)); }
+private:
+	struct Created {
+		HBITMAP bitmap;
+		void* bits;
+	};
+	static Created Create(HDC hdc, int width, int height) {
+		BITMAPINFO bmi = {};
+		bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bmi.bmiHeader.biWidth = width;
+		bmi.bmiHeader.biHeight = -height;
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 32;
+		bmi.bmiHeader.biCompression = BI_RGB;
+		Created result;
+		result.bitmap = winapi_call(CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &result.bits, NULL, 0));
+		return result;
+	}
+	DibSection(Created created, int width, int height) noexcept :
+		Bitmap(created.bitmap),
+		bits(static_cast<std::uint32_t*>(created.bits)),
+		width(width),
+		height(height)
+	{}
+	std::uint32_t* bits = nullptr;
+	int width = 0;
+	int height = 0;
+};
+
 class DC : public zero_or_resource<HDC> {
 public:
 	DC(HDC hdc) : zero_or_resource(hdc) {}
@@ -67,11 +165,211 @@ public:
 		return pt;
 	}
 	void LineTo(int x, int y) const { winapi_call(::LineTo(get(), x, y)); }
+	void Polyline(std::span<const POINT> points) const {
+		if (points.size() < 2) {
+			return;
+		}
+		winapi_call(::Polyline(get(), points.data(), int(points.size())));
+	}
+	void PolylineTo(std::span<const POINT> points) const {
+		if (points.empty()) {
+			return;
+		}
+		winapi_call(::PolylineTo(get(), points.data(), DWORD(points.size())));
+	}
+	// Each count must be at least 2 and together they must fit in points
+	void PolyPolyline(std::span<const POINT> points, std::span<const DWORD> counts) const {
+		if (counts.empty()) {
+			return;
+		}
+		std::size_t total = 0;
+		for (auto count : counts) {
+			if (count < 2 || count > points.size() - total) {
+				throw std::system_error(win32_errc(ERROR_INVALID_PARAMETER));
+			}
+			total += count;
+		}
+		winapi_call(::PolyPolyline(get(), points.data(), counts.data(), DWORD(counts.size())));
+	}
+	// Lines are gathered into fixed buffers and drawn in batches; a line
+	// that does not fit is drawn on its own
+	void PolyPolyline(std::span<const std::span<const POINT>> lines) const {
+		constexpr std::size_t MaxPoints = 512;
+		constexpr std::size_t MaxLines = 64;
+		POINT points[MaxPoints];
+		DWORD counts[MaxLines];
+		std::size_t pointCount = 0;
+		std::size_t lineCount = 0;
+		auto flush = [&] {
+			if (lineCount != 0) {
+				winapi_call(::PolyPolyline(get(), points, counts, DWORD(lineCount)));
+				pointCount = 0;
+				lineCount = 0;
+			}
+		};
+		for (auto& line : lines) {
+			if (line.size() < 2) {
+				continue;
+			}
+			if (line.size() > MaxPoints) {
+				flush();
+				Polyline(line);
+				continue;
+			}
+			if (pointCount + line.size() > MaxPoints || lineCount == MaxLines) {
+				flush();
+			}
+			std::copy(line.begin(), line.end(), points + pointCount);
+			pointCount += line.size();
+			counts[lineCount++] = DWORD(line.size());
+		}
+		flush();
+	}
+	void PolyBezier(std::span<const POINT> points) const {
+		if (points.empty()) {
+			return;
+		}
+		winapi_call(::PolyBezier(get(), points.data(), DWORD(points.size())));
+	}
+	void PolyBezierTo(std::span<const POINT> points) const {
+		if (points.empty()) {
+			return;
+		}
+		winapi_call(::PolyBezierTo(get(), points.data(), DWORD(points.size())));
+	}
 	COLORREF SetPenColor(COLORREF color) const { return winapi_call(::SetDCPenColor(get(), color), invalid_color_error_check); }
 	COLORREF SetPixel(int x, int y, COLORREF color) const { return winapi_call(::SetPixel(get(), x, y, color), invalid_color_error_check); }
     void FillRect(const RECT* rc, HBRUSH brush) const { winapi_call(::FillRect(get(), rc, brush)); }
     void FillRect(const RECT& rc, HBRUSH brush) const { FillRect(&rc, brush); }
 	int GetCaps(int index) const { return ::GetDeviceCaps(*this, index); }
+	void BitBlt(int x, int y, int cx, int cy, HDC src, int x1, int y1, DWORD rop) const {
+		winapi_call(::BitBlt(get(), x, y, cx, cy, src, x1, y1, rop));
+	}
+	void BitBlt(const RECT& rc, HDC src, DWORD rop = SRCCOPY) const {
+		BitBlt(rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, src, rc.left, rc.top, rop);
+	}
+	void StretchBlt(int x, int y, int cx, int cy, HDC src, int x1, int y1, int cx1, int cy1, DWORD rop) const {
+		winapi_call(::StretchBlt(get(), x, y, cx, cy, src, x1, y1, cx1, cy1, rop));
+	}
+	int SetStretchBltMode(int mode) const { return winapi_call(::SetStretchBltMode(get(), mode)); }
+	int GetDIBits(HBITMAP bitmap, UINT start, UINT lines, void* bits, BITMAPINFO* bmi, UINT usage) const {
+		return winapi_call(::GetDIBits(get(), bitmap, start, lines, bits, bmi, usage), GetDIBits_error_check);
+	}
+	void ReadPixels(HBITMAP bitmap, int width, int height, std::span<std::uint32_t> pixels) const {
+		if (pixels.size() < std::size_t(width) * std::size_t(height)) {
+			throw std::system_error(win32_errc(ERROR_INSUFFICIENT_BUFFER));
+		}
+		BITMAPINFO bmi = {};
+		bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bmi.bmiHeader.biWidth = width;
+		bmi.bmiHeader.biHeight = -height;
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 32;
+		bmi.bmiHeader.biCompression = BI_RGB;
+		GetDIBits(bitmap, 0, UINT(height), pixels.data(), &bmi, DIB_RGB_COLORS);
+	}
+};
+
+// Reduces a series sorted by x to at most four points per pixel column: the
+// first and last, which carry the line into and out of the column, and the
+// min and max y, in original order. Polyline draws the result unchanged.
+inline void DecimateMinMax(std::span<const POINT> points, std::vector<POINT>& result) {
+	result.clear();
+	std::size_t i = 0;
+	while (i < points.size()) {
+		auto x = points[i].x;
+		auto first = i;
+		auto minIdx = i;
+		auto maxIdx = i;
+		for (++i; i < points.size() && points[i].x == x; ++i) {
+			if (points[i].y < points[minIdx].y) {
+				minIdx = i;
+			}
+			if (points[i].y > points[maxIdx].y) {
+				maxIdx = i;
+			}
+		}
+		std::size_t keep[] = { first, std::min(minIdx, maxIdx), std::max(minIdx, maxIdx), i - 1 };
+		for (std::size_t k = 0; k < std::size(keep); ++k) {
+			if (k == 0 || keep[k] != keep[k - 1]) {
+				result.push_back(points[keep[k]]);
+			}
+		}
+	}
+}
+
+inline auto DecimateMinMax(std::span<const POINT> points) -> std::vector<POINT> {
+	std::vector<POINT> result;
+	DecimateMinMax(points, result);
+	return result;
+}
+
+class MemoryDC : public DC {
+public:
+	MemoryDC() noexcept : DC(NULL) {}
+	explicit MemoryDC(HDC compatible) : DC(winapi_call(CreateCompatibleDC(compatible))) {}
+	~MemoryDC() { if (get() != NULL) { DeleteDC(*this); } }
+	MemoryDC(const MemoryDC&) = delete;
+	MemoryDC& operator=(const MemoryDC&) = delete;
+	MemoryDC(MemoryDC&&) = default;
+	MemoryDC& operator=(MemoryDC&&) = default;
+};
+
+class SelectGuard {
+public:
+	SelectGuard(HDC hdc, HGDIOBJ obj) : hdc(hdc), prev(winapi_call(::SelectObject(hdc, obj))) {}
+	~SelectGuard() { ::SelectObject(hdc, prev); }
+	SelectGuard(const SelectGuard&) = delete;
+	SelectGuard& operator=(const SelectGuard&) = delete;
+	HGDIOBJ Previous() const { return prev; }
+private:
+	HDC hdc;
+	HGDIOBJ prev;
+};
+
+// Reads a region of a DC into a caller-provided top-down 32bpp buffer,
+// optionally downscaled. The staging DC and bitmap are kept between calls.
+class FrameGrabber {
+public:
+	FrameGrabber() = default;
+	FrameGrabber(const FrameGrabber&) = delete;
+	FrameGrabber& operator=(const FrameGrabber&) = delete;
+	FrameGrabber(FrameGrabber&&) = default;
+	FrameGrabber& operator=(FrameGrabber&&) = default;
+	void Capture(HDC src, const RECT& region, int width, int height, std::span<std::uint32_t> pixels, bool rgba = false) {
+		if (dc.get() == NULL) {
+			dc = MemoryDC(src);
+			dc.SetStretchBltMode(HALFTONE);
+			winapi_call(::SetBrushOrgEx(dc, 0, 0, nullptr));
+		}
+		if (bitmap.get() == NULL || width != this->width || height != this->height) {
+			bitmap = Bitmap(src, width, height);
+			this->width = width;
+			this->height = height;
+		}
+		{
+			SelectGuard select(dc, bitmap);
+			int srcWidth = region.right - region.left;
+			int srcHeight = region.bottom - region.top;
+			if (srcWidth == width && srcHeight == height) {
+				dc.BitBlt(0, 0, width, height, src, region.left, region.top, SRCCOPY);
+			} else {
+				dc.StretchBlt(0, 0, width, height, src, region.left, region.top, srcWidth, srcHeight, SRCCOPY);
+			}
+		}
+		dc.ReadPixels(static_cast<HBITMAP>(bitmap.get()), width, height, pixels);
+		if (rgba) {
+			convert_bgra_to_rgba(pixels.first(std::size_t(width) * std::size_t(height)));
+		}
+	}
+	void Capture(HDC src, const RECT& region, std::span<std::uint32_t> pixels, bool rgba = false) {
+		Capture(src, region, region.right - region.left, region.bottom - region.top, pixels, rgba);
+	}
+private:
+	Bitmap bitmap;
+	MemoryDC dc;
+	int width = 0;
+	int height = 0;
 };
 
 class PaintDC : private PAINTSTRUCT, public DC {
@@ -87,6 +385,71 @@ private:
 	HWND hWnd;
 };
 
+class PaintBuffer {
+public:
+	PaintBuffer() = default;
+	PaintBuffer(const PaintBuffer&) = delete;
+	PaintBuffer& operator=(const PaintBuffer&) = delete;
+	PaintBuffer(PaintBuffer&&) = default;
+	PaintBuffer& operator=(PaintBuffer&&) = default;
+	HDC Prepare(HDC target, int width, int height) {
+		width = std::max(width, 1);
+		height = std::max(height, 1);
+		if (dc.get() == NULL) {
+			dc = MemoryDC(target);
+		}
+		if (bitmap.get() == NULL || width > this->width || height > this->height) {
+			Bitmap newBitmap(target, width, height);
+			dc.SelectObject(newBitmap);
+			bitmap = std::move(newBitmap);
+			this->width = width;
+			this->height = height;
+		}
+		return dc;
+	}
+	void Release() {
+		dc = MemoryDC();
+		bitmap = Bitmap();
+		width = 0;
+		height = 0;
+	}
+	SIZE GetSize() const { return { width, height }; }
+private:
+	Bitmap bitmap;
+	MemoryDC dc;
+	int width = 0;
+	int height = 0;
+};
+
+class BufferedPaintDC : public DC {
+public:
+	BufferedPaintDC(HWND hWnd, PaintBuffer& buffer) : DC(NULL), paint(hWnd) {
+		RECT rc;
+		winapi_call(::GetClientRect(hWnd, &rc));
+		resource = buffer.Prepare(paint, rc.right - rc.left, rc.bottom - rc.top);
+	}
+	// Blits the buffer if End was not called, ignoring errors
+	~BufferedPaintDC() {
+		if (!ended) {
+			try {
+				paint.BitBlt(paint->rcPaint, *this);
+			} catch (const std::system_error&) {}
+		}
+	}
+	// Blits the buffer to the window and reports a failure
+	void End() {
+		ended = true;
+		paint.BitBlt(paint->rcPaint, *this);
+	}
+	BufferedPaintDC(const BufferedPaintDC&) = delete;
+	BufferedPaintDC& operator=(const BufferedPaintDC&) = delete;
+	const PAINTSTRUCT* operator ->() const { return paint.operator->(); }
+	const DC& Target() const { return paint; }
+private:
+	PaintDC paint;
+	bool ended = false;
+};
+
 enum class GetDCExFlags {
 	Window = DCX_WINDOW,
 	Cache = DCX_CACHE,
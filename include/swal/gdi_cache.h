@@ -0,0 +1,174 @@
+#ifndef SWAL_GDI_CACHE_H
+#define SWAL_GDI_CACHE_H
+
+#include "win_headers.h"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include "error.h"
+#include "gdi.h"
+
+namespace swal {
+
+// Process-wide LRU cache of pens and brushes. Entries handed out stay alive
+// until the last reference is dropped, even if evicted in the meantime, so
+// Capacity bounds the number of handles the cache itself keeps around, and
+// Limit bounds all handles it created that are still alive, cached or not.
+// At the limit, entries nobody else holds are evicted first; if that does
+// not free a handle, Get throws ERROR_NO_SYSTEM_RESOURCES.
+class GdiCache {
+public:
+	explicit GdiCache(std::size_t capacity = 256, std::size_t limit = 1024) :
+		capacity(capacity), limit(limit) {}
+	GdiCache(const GdiCache&) = delete;
+	GdiCache& operator=(const GdiCache&) = delete;
+	static GdiCache& instance() {
+		static GdiCache instance;
+		return instance;
+	}
+	std::shared_ptr<const Pen> GetPen(int style, int width, COLORREF color) {
+		return std::static_pointer_cast<const Pen>(Get({ KindPen, style, width, color }, [&]{
+			return std::make_unique<Pen>(style, width, color);
+		}));
+	}
+	std::shared_ptr<const Pen> GetPen(PenStyle style, int width, COLORREF color) {
+		return GetPen(static_cast<int>(style), width, color);
+	}
+	std::shared_ptr<const Pen> GetPen(COLORREF color) {
+		return GetPen(PenStyle::Solid, 1, color);
+	}
+	std::shared_ptr<const Brush> GetBrush(COLORREF color) {
+		return std::static_pointer_cast<const Brush>(Get({ KindSolidBrush, 0, 0, color }, [&]{
+			return std::make_unique<Brush>(color);
+		}));
+	}
+	std::shared_ptr<const Brush> GetBrush(HatchStyle hatch, COLORREF color) {
+		return std::static_pointer_cast<const Brush>(Get({ KindHatchBrush, static_cast<int>(hatch), 0, color }, [&]{
+			return std::make_unique<Brush>(hatch, color);
+		}));
+	}
+	void SetCapacity(std::size_t capacity) {
+		std::lock_guard lock(mutex);
+		this->capacity = capacity;
+		Trim();
+	}
+	std::size_t Capacity() const {
+		std::lock_guard lock(mutex);
+		return capacity;
+	}
+	void SetLimit(std::size_t limit) {
+		std::lock_guard lock(mutex);
+		this->limit = limit;
+	}
+	std::size_t Limit() const {
+		std::lock_guard lock(mutex);
+		return limit;
+	}
+	std::size_t Size() const {
+		std::lock_guard lock(mutex);
+		return lru.size();
+	}
+	// Handles created by the cache that are still alive, checked out or not
+	std::size_t HandleCount() const {
+		return live->load(std::memory_order_relaxed);
+	}
+	void Clear() {
+		std::lock_guard lock(mutex);
+		index.clear();
+		lru.clear();
+	}
+private:
+	enum Kind {
+		KindPen,
+		KindSolidBrush,
+		KindHatchBrush
+	};
+	struct Key {
+		Kind kind;
+		int style;
+		int width;
+		COLORREF color;
+		bool operator==(const Key&) const = default;
+	};
+	struct KeyHash {
+		std::size_t operator()(const Key& key) const noexcept {
+			std::size_t h = std::hash<int>()(key.kind);
+			h = h * 31 + std::hash<int>()(key.style);
+			h = h * 31 + std::hash<int>()(key.width);
+			return h * 31 + std::hash<COLORREF>()(key.color);
+		}
+	};
+	struct Entry {
+		Key key;
+		std::shared_ptr<const GdiObj> obj;
+	};
+	// Shares the count with the cache, so handles may outlive it
+	struct Release {
+		std::shared_ptr<std::atomic<std::size_t>> live;
+		template <typename T>
+		void operator()(const T* obj) const noexcept {
+			delete obj;
+			live->fetch_sub(1, std::memory_order_relaxed);
+		}
+	};
+	template <typename F>
+	std::shared_ptr<const GdiObj> Get(const Key& key, F&& create) {
+		std::lock_guard lock(mutex);
+		auto it = index.find(key);
+		if (it != index.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			return it->second->obj;
+		}
+		if (live->load(std::memory_order_relaxed) >= limit) {
+			Reclaim();
+			if (live->load(std::memory_order_relaxed) >= limit) {
+				throw std::system_error(win32_errc(ERROR_NO_SYSTEM_RESOURCES));
+			}
+		}
+		auto created = create().release();
+		live->fetch_add(1, std::memory_order_relaxed);
+		lru.push_front({ key, std::shared_ptr<const GdiObj>(created, Release{ live }) });
+		try {
+			index.emplace(key, lru.begin());
+		} catch (...) {
+			lru.pop_front();
+			throw;
+		}
+		auto result = lru.front().obj;
+		Trim();
+		return result;
+	}
+	void Trim() {
+		while (lru.size() > capacity) {
+			index.erase(lru.back().key);
+			lru.pop_back();
+		}
+	}
+	// Evicts the least recently used entry that only the cache holds, as
+	// evicting one that is checked out would not free its handle
+	void Reclaim() {
+		for (auto it = lru.end(); it != lru.begin();) {
+			--it;
+			if (it->obj.use_count() == 1) {
+				index.erase(it->key);
+				lru.erase(it);
+				return;
+			}
+		}
+	}
+	mutable std::mutex mutex;
+	std::size_t capacity;
+	std::size_t limit;
+	std::shared_ptr<std::atomic<std::size_t>> live = std::make_shared<std::atomic<std::size_t>>(0);
+	std::list<Entry> lru;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+};
+
+}
+
+#endif // SWAL_GDI_CACHE_H
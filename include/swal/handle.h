@@ -9,7 +9,10 @@
 #define SWAL_HANDLE_H
 
 #include "win_headers.h"
+#include <chrono>
+#include <stop_token>
 #include <string>
+#include <vector>
 #include "enum_bitwise.h"
 #include "error.h"
 #include "strconv.h"
@@ -81,6 +84,95 @@ public:
 #endif
 };
 
+template <typename T>
+class WaitableTimerHandle {
+private:
+	HANDLE handle() const {
+		return static_cast<const T&>(*this);
+	}
+public:
+	void Set(const LARGE_INTEGER& due, LONG period, PTIMERAPCROUTINE apc, void* arg, bool resume) const {
+		winapi_call(SetWaitableTimer(handle(), &due, period, apc, arg, resume));
+	}
+	void SetRelative(std::chrono::nanoseconds due, LONG period = 0) const {
+		LARGE_INTEGER li;
+		li.QuadPart = -std::max<LONGLONG>(due.count() / 100, 0);
+		Set(li, period, nullptr, nullptr, false);
+	}
+	void SetAbsolute(const FILETIME& due, LONG period = 0) const {
+		LARGE_INTEGER li;
+		li.LowPart = due.dwLowDateTime;
+		li.HighPart = LONG(due.dwHighDateTime);
+		Set(li, period, nullptr, nullptr, false);
+	}
+	void SetAbsolute(std::chrono::system_clock::time_point due, LONG period = 0) const {
+		constexpr LONGLONG unixEpoch = 116444736000000000;
+		LARGE_INTEGER li;
+		li.QuadPart = unixEpoch + std::chrono::duration_cast<std::chrono::duration<LONGLONG, std::ratio<1, 10000000>>>(due.time_since_epoch()).count();
+		Set(li, period, nullptr, nullptr, false);
+	}
+	void Cancel() const { winapi_call(CancelWaitableTimer(handle())); }
+};
+
+#if _WIN32_WINNT >= 0x0600
+enum class WaitableTimerFlags {
+	None = 0,
+	ManualReset = CREATE_WAITABLE_TIMER_MANUAL_RESET,
+#ifdef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+	HighResolution = CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+#endif
+};
+
+template <> struct enable_enum_bitwise<enum WaitableTimerFlags> : std::true_type {};
+#endif
+
+class WaitableTimer : public Handle, public OwnableHandle<WaitableTimer>, public WaitableTimerHandle<WaitableTimer>, public WaitableHandle<WaitableTimer> {
+public:
+	WaitableTimer() noexcept : Handle(NULL) {}
+	WaitableTimer(SECURITY_ATTRIBUTES* sattrs, bool manualReset, LPCTSTR name)
+		: Handle(winapi_call(CreateWaitableTimer(sattrs, manualReset, name))) {}
+	explicit WaitableTimer(bool manualReset)
+		: WaitableTimer(nullptr, manualReset, nullptr) {}
+#if _WIN32_WINNT >= 0x0600
+	WaitableTimer(SECURITY_ATTRIBUTES* sattrs, LPCTSTR name, DWORD flags, DWORD access)
+		: Handle(winapi_call(CreateWaitableTimerEx(sattrs, name, flags, access))) {}
+	WaitableTimer(WaitableTimerFlags flags, DWORD access = TIMER_ALL_ACCESS)
+		: WaitableTimer(nullptr, nullptr, static_cast<DWORD>(flags), access) {}
+	static WaitableTimer PreferHighResolution(bool manualReset, DWORD access = TIMER_ALL_ACCESS) {
+		auto flags = manualReset ? WaitableTimerFlags::ManualReset : WaitableTimerFlags::None;
+#ifdef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+		try {
+			return { flags | WaitableTimerFlags::HighResolution, access };
+		} catch (const std::system_error&) {
+			// not supported before Windows 10 1803
+		}
+#endif
+		return { flags, access };
+	}
+#endif
+};
+
+#if _WIN32_WINNT >= 0x0600
+// Cancels exactly one pending overlapped operation when stop is requested.
+// Create it after the operation has been issued and keep it alive until the
+// operation has completed; the cancelled operation reports
+// ERROR_OPERATION_ABORTED, which winapi_call throws as operation_aborted.
+class CancelIoOnStop {
+public:
+	CancelIoOnStop(HANDLE file, OVERLAPPED& ovl, std::stop_token token) :
+		callback(std::move(token), Canceller{ file, &ovl }) {}
+	CancelIoOnStop(const CancelIoOnStop&) = delete;
+	CancelIoOnStop& operator=(const CancelIoOnStop&) = delete;
+private:
+	struct Canceller {
+		HANDLE file;
+		OVERLAPPED* ovl;
+		void operator()() const noexcept { ::CancelIoEx(file, ovl); }
+	};
+	std::stop_callback<Canceller> callback;
+};
+#endif
+
 enum class SetPointerModes {
 	Begin = FILE_BEGIN,
 	Current = FILE_CURRENT,
@@ -129,6 +221,14 @@ public:
     {
         GetOverlappedResult(&ovl, &transferred, wait);
     }
+#if _WIN32_WINNT >= 0x0600
+    DWORD Read(LPVOID buffer, DWORD size, OVERLAPPED& ovl, std::stop_token token) const
+    {
+        Read(buffer, size, nullptr, &ovl);
+        CancelIoOnStop cancel(handle(), ovl, std::move(token));
+        return GetOverlappedResult(ovl);
+    }
+#endif
     BOOL Write(LPCVOID buffer, DWORD size, DWORD* bytesWritten, OVERLAPPED* ovl) const
     {
         return winapi_call(
@@ -150,6 +250,14 @@ public:
     {
         return Write(buffer, size, &bytesWritten, &ovl);
     }
+#if _WIN32_WINNT >= 0x0600
+    DWORD Write(LPCVOID buffer, DWORD size, OVERLAPPED& ovl, std::stop_token token) const
+    {
+        Write(buffer, size, nullptr, &ovl);
+        CancelIoOnStop cancel(handle(), ovl, std::move(token));
+        return GetOverlappedResult(ovl);
+    }
+#endif
     void SetPointerEx(LARGE_INTEGER dist, LARGE_INTEGER* nPtr, DWORD mode) const {
 		swal::winapi_call(::SetFilePointerEx(handle(), dist, nPtr, mode));
 	}
@@ -174,6 +282,21 @@ public:
 	void CancelIoEx(OVERLAPPED& ovl) const {
 		CancelIoEx(&ovl);
 	}
+#endif
+#if _WIN32_WINNT >= 0x0600
+	// Fills buffer with FILE_ID_BOTH_DIR_INFO records for a directory opened
+	// with FILE_FLAG_BACKUP_SEMANTICS; returns false once it is exhausted
+	bool QueryDirectory(void* buffer, DWORD size, bool restart = false) const {
+		auto infoClass = restart ? FileIdBothDirectoryRestartInfo : FileIdBothDirectoryInfo;
+		if (::GetFileInformationByHandleEx(handle(), infoClass, buffer, size)) {
+			return true;
+		}
+		auto err = GetLastError();
+		if (err == ERROR_NO_MORE_FILES) {
+			return false;
+		}
+		throw std::system_error(win32_errc(err));
+	}
 #endif
 	LARGE_INTEGER GetSizeEx() const {
 		LARGE_INTEGER result;
@@ -197,6 +320,96 @@ public:
         DeviceIoControl(code, inb, ins, outb, outs, &wr, nullptr);
         return wr;
 	}
+	BY_HANDLE_FILE_INFORMATION GetInformation() const {
+		BY_HANDLE_FILE_INFORMATION result;
+		winapi_call(::GetFileInformationByHandle(handle(), &result));
+		return result;
+	}
+#if _WIN32_WINNT >= 0x0600
+	template <typename Info>
+	Info GetInformation(FILE_INFO_BY_HANDLE_CLASS infoClass) const {
+		Info result;
+		winapi_call(::GetFileInformationByHandleEx(handle(), infoClass, &result, sizeof(result)));
+		return result;
+	}
+	template <typename Info>
+	void SetInformation(FILE_INFO_BY_HANDLE_CLASS infoClass, const Info& info) const {
+		winapi_call(::SetFileInformationByHandle(handle(), infoClass, const_cast<Info*>(&info), sizeof(info)));
+	}
+	FILE_BASIC_INFO GetBasicInfo() const {
+		return GetInformation<FILE_BASIC_INFO>(FileBasicInfo);
+	}
+	void SetBasicInfo(const FILE_BASIC_INFO& info) const {
+		SetInformation(FileBasicInfo, info);
+	}
+	FILE_STANDARD_INFO GetStandardInfo() const {
+		return GetInformation<FILE_STANDARD_INFO>(FileStandardInfo);
+	}
+#if _WIN32_WINNT >= 0x0602
+	FILE_ID_INFO GetIdInfo() const {
+		return GetInformation<FILE_ID_INFO>(FileIdInfo);
+	}
+#endif
+	// Reserves clusters without changing the file size, so that appends
+	// up to size neither fragment the file nor extend its allocation
+	void SetAllocationSize(LONGLONG size) const {
+		FILE_ALLOCATION_INFO info;
+		info.AllocationSize.QuadPart = size;
+		SetInformation(FileAllocationInfo, info);
+	}
+	void SetEndOfFile(LONGLONG size) const {
+		FILE_END_OF_FILE_INFO info;
+		info.EndOfFile.QuadPart = size;
+		SetInformation(FileEndOfFileInfo, info);
+	}
+	void SetDeleteOnClose(bool deleteFile = true) const {
+		FILE_DISPOSITION_INFO info;
+		info.DeleteFile = deleteFile;
+		SetInformation(FileDispositionInfo, info);
+	}
+#endif
+	void SetSparse(bool sparse = true) const {
+		FILE_SET_SPARSE_BUFFER buffer;
+		buffer.SetSparse = sparse;
+		DeviceIoControl(FSCTL_SET_SPARSE, &buffer, sizeof(buffer), nullptr, 0);
+	}
+	// Zeroes [offset, offset + length); on a sparse file the range is
+	// deallocated instead of written
+	void ZeroRange(LONGLONG offset, LONGLONG length) const {
+		FILE_ZERO_DATA_INFORMATION info;
+		info.FileOffset.QuadPart = offset;
+		info.BeyondFinalZero.QuadPart = offset + length;
+		DeviceIoControl(FSCTL_SET_ZERO_DATA, &info, sizeof(info), nullptr, 0);
+	}
+	// Returns the allocated ranges of a sparse file within [offset, offset + length)
+	std::vector<FILE_ALLOCATED_RANGE_BUFFER> QueryAllocatedRanges(LONGLONG offset, LONGLONG length) const {
+		std::vector<FILE_ALLOCATED_RANGE_BUFFER> result(16);
+		FILE_ALLOCATED_RANGE_BUFFER query;
+		query.FileOffset.QuadPart = offset;
+		query.Length.QuadPart = length;
+		std::size_t count = 0;
+		for (;;) {
+			DWORD bytes = 0;
+			auto ok = ::DeviceIoControl(handle(), FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query),
+				result.data() + count, DWORD((result.size() - count) * sizeof(FILE_ALLOCATED_RANGE_BUFFER)), &bytes, nullptr);
+			auto err = ok ? ERROR_SUCCESS : GetLastError();
+			if (err != ERROR_SUCCESS && err != ERROR_MORE_DATA) {
+				throw std::system_error(win32_errc(err));
+			}
+			count += bytes / sizeof(FILE_ALLOCATED_RANGE_BUFFER);
+			if (err == ERROR_SUCCESS || bytes == 0) {
+				break;
+			}
+			// continue after the last range returned
+			auto& last = result[count - 1];
+			auto end = last.FileOffset.QuadPart + last.Length.QuadPart;
+			query.Length.QuadPart -= end - query.FileOffset.QuadPart;
+			query.FileOffset.QuadPart = end;
+			result.resize(result.size() * 2);
+		}
+		result.resize(count);
+		return result;
+	}
 };
 
 enum class ShareMode {
@@ -225,6 +438,7 @@ public:
 class File : public FileHandle, public OwnableHandle<File>, public WaitableHandle<File> {
 public:
 	File() noexcept : FileHandle(INVALID_HANDLE_VALUE) {}
+	explicit File(HANDLE handle) noexcept : FileHandle(handle) {}
 	File(LPCTSTR filename, DWORD access, DWORD shareMode, SECURITY_ATTRIBUTES* secattrs, DWORD createMode, DWORD flags, HANDLE tmplt)
 		: FileHandle(winapi_call(CreateFile(filename, access, shareMode, secattrs, createMode, flags, tmplt), CreateFile_error_check)) {}
 	File(const tstring& filename, DWORD access, ShareMode shareMode, SECURITY_ATTRIBUTES& secattrs, CreateMode createMode, DWORD flags, const Handle& tmplt)
@@ -237,6 +451,42 @@ public:
         : File(filename, access, shareMode, createMode, flags, NULL) {}
 };
 
+class MappedView : public zero_or_resource<void*> {
+public:
+	MappedView() noexcept : zero_or_resource(nullptr) {}
+	MappedView(HANDLE mapping, DWORD access, ULONGLONG offset, SIZE_T size)
+		: zero_or_resource(winapi_call(MapViewOfFile(mapping, access, DWORD(offset >> 32), DWORD(offset), size))) {}
+	~MappedView() { if (get() != nullptr) { UnmapViewOfFile(get()); } }
+	MappedView(const MappedView&) = delete;
+	MappedView& operator=(const MappedView&) = delete;
+	MappedView(MappedView&&) noexcept = default;
+	MappedView& operator=(MappedView&&) noexcept = default;
+	template <typename T>
+	T* As() const { return static_cast<T*>(get()); }
+	// Size of the view in whole pages
+	SIZE_T Size() const {
+		MEMORY_BASIC_INFORMATION info;
+		winapi_call(VirtualQuery(get(), &info, sizeof(info)));
+		return info.RegionSize;
+	}
+};
+
+class FileMapping : public Handle, public OwnableHandle<FileMapping> {
+public:
+	FileMapping() noexcept : Handle(NULL) {}
+	FileMapping(HANDLE file, SECURITY_ATTRIBUTES* sattrs, DWORD protect, ULONGLONG maxSize, LPCTSTR name)
+		: Handle(winapi_call(CreateFileMapping(file, sattrs, protect, DWORD(maxSize >> 32), DWORD(maxSize), name))) {}
+	FileMapping(const Handle& file, DWORD protect, ULONGLONG maxSize = 0)
+		: FileMapping(file, nullptr, protect, maxSize, nullptr) {}
+	FileMapping(const tstring& name, DWORD protect, ULONGLONG size)
+		: FileMapping(INVALID_HANDLE_VALUE, nullptr, protect, size, name.c_str()) {}
+	FileMapping(DWORD access, bool inherit, const tstring& name)
+		: Handle(winapi_call(OpenFileMapping(access, inherit, name.c_str()))) {}
+	MappedView Map(DWORD access, ULONGLONG offset = 0, SIZE_T size = 0) const {
+		return { *this, access, offset, size };
+	}
+};
+
 struct CompletionStatusResult {
 	DWORD error;
 	DWORD bytesTransfered;
@@ -252,6 +502,9 @@ private:
 	}
 public:
 	void AssocFile(const Handle& file, ULONG_PTR key) const {
+		AssocFile(file.get(), key);
+	}
+	void AssocFile(HANDLE file, ULONG_PTR key) const {
 		winapi_call(CreateIoCompletionPort(file, handle(), key, 0));
 	}
 	CompletionStatusResult GetQueuedCompletionStatus(DWORD timeout) const {
@@ -286,6 +539,46 @@ public:
 		: Handle(winapi_call(CreateIoCompletionPort(file, NULL, key, thrNum))) {}
 };
 
+// OVERLAPPED that knows how to complete itself, so that one completion key
+// can serve any number of outstanding requests
+class IoOperation : public OVERLAPPED {
+public:
+	using Completion = void(*)(IoOperation&, DWORD error, DWORD transferred);
+	explicit IoOperation(Completion completion) noexcept : OVERLAPPED{}, completion(completion) {}
+	IoOperation(const IoOperation&) = delete;
+	IoOperation& operator=(const IoOperation&) = delete;
+	void Complete(DWORD error, DWORD transferred) {
+		completion(*this, error, transferred);
+	}
+private:
+	Completion completion;
+};
+
+// Routes completion packets for key to the IoOperation that issued them.
+// Files must be opened with FILE_FLAG_OVERLAPPED and associated through
+// Associate. An operation that completes inline while the file skips the
+// port on success gets no packet, so its issuer must complete it.
+class IoDispatcher {
+public:
+	template <typename T>
+	IoDispatcher(const IOCompletionPortHandle<T>& port, ULONG_PTR key) noexcept :
+		port(static_cast<const T&>(port)), key(key) {}
+	void Associate(HANDLE file) const {
+		winapi_call(CreateIoCompletionPort(file, port, key, 0));
+	}
+	// Returns false if the packet does not belong to this dispatcher
+	bool HandleCompletion(const CompletionStatusResult& status) const {
+		if (status.key != key || status.ovl == nullptr) {
+			return false;
+		}
+		static_cast<IoOperation*>(status.ovl)->Complete(status.error, status.bytesTransfered);
+		return true;
+	}
+private:
+	HANDLE port;
+	ULONG_PTR key;
+};
+
 }
 
 #endif /* SWAL_HANDLE_H */
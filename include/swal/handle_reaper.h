@@ -0,0 +1,231 @@
+#ifndef SWAL_HANDLE_REAPER_H
+#define SWAL_HANDLE_REAPER_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include "handle.h"
+
+namespace swal {
+
+// Closes handles on a background thread so that a slow CloseHandle (pending
+// writes, network shares) does not block the caller. Handles are passed
+// through a bounded lock-free queue; when it is full or the reaper is shut
+// down they are closed inline. Shutdown (also run by the destructor) closes
+// everything still queued.
+class HandleReaper {
+public:
+	struct Stats {
+		std::size_t depth;
+		std::size_t maxDepth;
+		std::size_t queued;
+		std::size_t closed;
+		std::size_t closedInline;
+	};
+	explicit HandleReaper(std::size_t capacity = 4096) :
+		cells(std::make_unique<Cell[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))),
+		mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+		wake(false, false)
+	{
+		for (std::size_t i = 0; i <= mask; ++i) {
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+		thread = std::thread([this]{ Run(); });
+	}
+	~HandleReaper() { Shutdown(); }
+	HandleReaper(const HandleReaper&) = delete;
+	HandleReaper& operator=(const HandleReaper&) = delete;
+	static HandleReaper& instance() {
+		struct Shared {
+			HandleReaper reaper;
+			~Shared() { sharedDestroyed.store(true, std::memory_order_release); }
+		};
+		static Shared shared;
+		return shared.reaper;
+	}
+	// Closes handle through instance(), or inline once static destruction
+	// has destroyed it
+	static void CloseDeferred(HANDLE handle) noexcept {
+		if (sharedDestroyed.load(std::memory_order_acquire)) {
+			if (handle != NULL && handle != INVALID_HANDLE_VALUE) {
+				::CloseHandle(handle);
+			}
+			return;
+		}
+		instance().Close(handle);
+	}
+	void Close(HANDLE handle) noexcept {
+		if (handle == NULL || handle == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		std::size_t pos;
+		if (stopping.load(std::memory_order_acquire) || !TryPush(handle, pos)) {
+			::CloseHandle(handle);
+			closedInline.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		queued.fetch_add(1, std::memory_order_relaxed);
+		// the reaper sleeps only once it has consumed everything before this
+		// cell; if it has not, it is still draining and will get here
+		auto consumed = dequeuePos.load(std::memory_order_seq_cst);
+		UpdateMaxDepth(consumed <= pos ? pos + 1 - consumed : 0);
+		if (consumed == pos) {
+			::SetEvent(wake);
+		}
+		if (stopping.load(std::memory_order_acquire)) {
+			Drain();
+		}
+	}
+	// Waits until every handle queued before the call has been closed
+	void Flush() {
+		auto target = queued.load(std::memory_order_acquire);
+		wake.Set();
+		auto done = closed.load(std::memory_order_acquire);
+		while (done < target) {
+			closed.wait(done, std::memory_order_acquire);
+			done = closed.load(std::memory_order_acquire);
+		}
+	}
+	void Shutdown() noexcept {
+		if (stopping.exchange(true, std::memory_order_acq_rel)) {
+			return;
+		}
+		::SetEvent(wake);
+		if (thread.joinable()) {
+			thread.join();
+		}
+		Drain();
+	}
+	Stats GetStats() const noexcept {
+		auto dequeued = dequeuePos.load(std::memory_order_relaxed);
+		auto enqueued = enqueuePos.load(std::memory_order_relaxed);
+		return {
+			enqueued > dequeued ? enqueued - dequeued : 0,
+			maxDepth.load(std::memory_order_relaxed),
+			queued.load(std::memory_order_relaxed),
+			closed.load(std::memory_order_relaxed),
+			closedInline.load(std::memory_order_relaxed)
+		};
+	}
+private:
+	struct Cell {
+		std::atomic<std::size_t> seq;
+		HANDLE handle;
+	};
+	static constexpr std::size_t BatchSize = 64;
+	bool TryPush(HANDLE handle, std::size_t& pos) noexcept {
+		pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = cells[pos & mask];
+			auto seq = cell.seq.load(std::memory_order_acquire);
+			auto diff = std::intptr_t(seq) - std::intptr_t(pos);
+			if (diff == 0) {
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					cell.handle = handle;
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	bool TryPop(HANDLE& handle) noexcept {
+		auto pos = dequeuePos.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = cells[pos & mask];
+			auto seq = cell.seq.load(std::memory_order_acquire);
+			auto diff = std::intptr_t(seq) - std::intptr_t(pos + 1);
+			if (diff == 0) {
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					handle = cell.handle;
+					cell.seq.store(pos + mask + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	void UpdateMaxDepth(std::size_t value) noexcept {
+		auto cur = maxDepth.load(std::memory_order_relaxed);
+		while (cur < value && !maxDepth.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+	}
+	std::size_t Drain() noexcept {
+		HANDLE batch[BatchSize];
+		std::size_t total = 0;
+		for (;;) {
+			std::size_t n = 0;
+			while (n < BatchSize && TryPop(batch[n])) {
+				++n;
+			}
+			if (n == 0) {
+				return total;
+			}
+			for (std::size_t i = 0; i < n; ++i) {
+				::CloseHandle(batch[i]);
+			}
+			closed.fetch_add(n, std::memory_order_release);
+			closed.notify_all();
+			total += n;
+		}
+	}
+	void Run() noexcept {
+		for (;;) {
+			Drain();
+			// a producer that has reserved a cell but not yet published it
+			// saw earlier cells unconsumed and does not signal, so wait for
+			// the cell instead of sleeping
+			if (enqueuePos.load(std::memory_order_seq_cst) != dequeuePos.load(std::memory_order_relaxed)) {
+				std::this_thread::yield();
+				continue;
+			}
+			if (stopping.load(std::memory_order_acquire)) {
+				return;
+			}
+			::WaitForSingleObject(wake, INFINITE);
+		}
+	}
+	std::unique_ptr<Cell[]> cells;
+	std::size_t mask;
+	alignas(64) std::atomic<std::size_t> enqueuePos = 0;
+	alignas(64) std::atomic<std::size_t> dequeuePos = 0;
+	alignas(64) std::atomic<std::size_t> maxDepth = 0;
+	std::atomic<std::size_t> queued = 0;
+	std::atomic<std::size_t> closed = 0;
+	std::atomic<std::size_t> closedInline = 0;
+	std::atomic<bool> stopping = false;
+	Event wake;
+	std::thread thread;
+	// trivially destructible, so it can still be read during static destruction
+	static inline std::atomic<bool> sharedDestroyed = false;
+};
+
+// Opt-in deferred close: DeferredClose<File> behaves like File but hands its
+// handle to HandleReaper::instance() instead of closing it in the destructor,
+// or closes it inline once static destruction has destroyed the reaper.
+template <typename T>
+class DeferredClose : public T {
+public:
+	using T::T;
+	DeferredClose(T&& other) noexcept : T(std::move(other)) {}
+	DeferredClose(DeferredClose&&) noexcept = default;
+	DeferredClose& operator=(DeferredClose&&) noexcept = default;
+	~DeferredClose() {
+		HandleReaper::CloseDeferred(std::exchange(this->resource, HANDLE(NULL)));
+	}
+};
+
+}
+
+#endif // SWAL_HANDLE_REAPER_H
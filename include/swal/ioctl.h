@@ -0,0 +1,158 @@
+#ifndef SWAL_IOCTL_H
+#define SWAL_IOCTL_H
+
+#include "win_headers.h"
+#include <coroutine>
+#include <memory>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include "error.h"
+#include "handle.h"
+
+namespace swal {
+
+// Binds a control code to its input and output types; either may be void
+template <DWORD Code, typename In = void, typename Out = void>
+struct Ioctl {
+	static constexpr DWORD code = Code;
+	using input = In;
+	using output = Out;
+};
+
+using DiskGetLengthInfo = Ioctl<IOCTL_DISK_GET_LENGTH_INFO, void, GET_LENGTH_INFORMATION>;
+using DiskPerformance = Ioctl<IOCTL_DISK_PERFORMANCE, void, DISK_PERFORMANCE>;
+using StorageGetDeviceNumber = Ioctl<IOCTL_STORAGE_GET_DEVICE_NUMBER, void, STORAGE_DEVICE_NUMBER>;
+using StorageCheckVerify = Ioctl<IOCTL_STORAGE_CHECK_VERIFY2>;
+using GetNtfsVolumeData = Ioctl<FSCTL_GET_NTFS_VOLUME_DATA, void, NTFS_VOLUME_DATA_BUFFER>;
+
+template <typename T>
+struct IoctlBuffer {
+	T value;
+	LPVOID data() const noexcept { return const_cast<T*>(&value); }
+	static constexpr DWORD size = sizeof(T);
+};
+
+template <>
+struct IoctlBuffer<void> {
+	LPVOID data() const noexcept { return nullptr; }
+	static constexpr DWORD size = 0;
+};
+
+template <typename I, typename... In>
+constexpr bool ioctl_input_matches = std::is_void_v<typename I::input> ?
+	sizeof...(In) == 0 : sizeof...(In) == 1;
+
+// Executes I synchronously; the input is omitted when I::input is void.
+// No OVERLAPPED is passed, which a handle opened with FILE_FLAG_OVERLAPPED
+// rejects with ERROR_INVALID_PARAMETER: use AsyncIoctl or BeginIoctl there.
+template <typename I, typename T, typename... In>
+auto DeviceIoControl(const FileOps<T>& file, const In&... in) -> typename I::output {
+	static_assert(ioctl_input_matches<I, In...>, "input does not match the IOCTL descriptor");
+	const IoctlBuffer<typename I::input> input{ in... };
+	IoctlBuffer<typename I::output> output{};
+	file.DeviceIoControl(I::code, input.data(), input.size, output.data(), output.size);
+	if constexpr (!std::is_void_v<typename I::output>) {
+		return output.value;
+	}
+}
+
+#if _WIN32_WINNT >= 0x0600
+
+// co_await AsyncIoctl<I>(file, in) resumes on the thread that dispatches
+// the completion and yields I::output or throws std::system_error
+template <typename I>
+class IoctlAwaiter : IoOperation {
+public:
+	template <typename... In>
+	explicit IoctlAwaiter(HANDLE file, const In&... in) :
+		IoOperation(Fire), file(file), input{ in... } {}
+	bool await_ready() const noexcept { return false; }
+	bool await_suspend(std::coroutine_handle<> handle) {
+		this->handle = handle;
+		// once issued the completion may resume the coroutine on another
+		// thread, so this must not be touched unless the call failed
+		if (::DeviceIoControl(file, I::code, input.data(), input.size, output.data(), output.size, nullptr, this)) {
+			return true;
+		}
+		auto err = GetLastError();
+		if (err == ERROR_IO_PENDING) {
+			return true;
+		}
+		error = err;
+		return false;
+	}
+	auto await_resume() -> typename I::output {
+		if (error != ERROR_SUCCESS) {
+			throw_win32_error(error);
+		}
+		if constexpr (!std::is_void_v<typename I::output>) {
+			return std::move(output.value);
+		}
+	}
+private:
+	static void Fire(IoOperation& op, DWORD error, DWORD) {
+		auto& self = static_cast<IoctlAwaiter&>(op);
+		self.error = error;
+		self.handle.resume();
+	}
+	HANDLE file;
+	const IoctlBuffer<typename I::input> input;
+	IoctlBuffer<typename I::output> output{};
+	DWORD error = ERROR_SUCCESS;
+	std::coroutine_handle<> handle;
+};
+
+template <typename I, typename... In>
+auto AsyncIoctl(HANDLE file, const In&... in) -> IoctlAwaiter<I> {
+	static_assert(ioctl_input_matches<I, In...>, "input does not match the IOCTL descriptor");
+	return IoctlAwaiter<I>(file, in...);
+}
+
+template <typename I, typename F>
+class IoctlRequest : IoOperation {
+public:
+	template <typename... In>
+	IoctlRequest(HANDLE file, F callback, const In&... in) :
+		IoOperation(Fire), file(file), callback(std::move(callback)), input{ in... } {}
+	// Returns the error if the request failed without queueing a packet
+	DWORD Issue() {
+		if (::DeviceIoControl(file, I::code, input.data(), input.size, output.data(), output.size, nullptr, this)) {
+			return ERROR_SUCCESS;
+		}
+		auto err = GetLastError();
+		return err == ERROR_IO_PENDING ? ERROR_SUCCESS : err;
+	}
+private:
+	static void Fire(IoOperation& op, DWORD error, DWORD) {
+		std::unique_ptr<IoctlRequest> self(static_cast<IoctlRequest*>(&op));
+		if constexpr (std::is_void_v<typename I::output>) {
+			self->callback(error);
+		} else {
+			self->callback(error, self->output.value);
+		}
+	}
+	HANDLE file;
+	F callback;
+	const IoctlBuffer<typename I::input> input;
+	IoctlBuffer<typename I::output> output{};
+};
+
+// Starts I and calls callback(DWORD error, I::output&) — or callback(error)
+// for a void output — on the thread that dispatches the completion. Throws
+// if the request could not be started.
+template <typename I, typename F, typename... In>
+void BeginIoctl(HANDLE file, F&& callback, const In&... in) {
+	static_assert(ioctl_input_matches<I, In...>, "input does not match the IOCTL descriptor");
+	auto request = std::make_unique<IoctlRequest<I, std::decay_t<F>>>(file, std::forward<F>(callback), in...);
+	if (auto err = request->Issue(); err != ERROR_SUCCESS) {
+		throw_win32_error(err);
+	}
+	request.release();
+}
+
+#endif
+
+}
+
+#endif // SWAL_IOCTL_H
@@ -0,0 +1,411 @@
+#ifndef SWAL_PIPE_H
+#define SWAL_PIPE_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "error.h"
+#include "handle.h"
+#include "strconv.h"
+
+namespace swal {
+
+template <typename T>
+class NamedPipeOps {
+private:
+	const Handle& handle() const {
+		return static_cast<const T&>(*this);
+	}
+public:
+	void Connect() const {
+		winapi_call(::ConnectNamedPipe(handle(), nullptr), ConnectNamedPipe_error_check);
+	}
+	// Returns true if a client connected before the call; no completion is
+	// reported for ovl in that case
+	bool Connect(OVERLAPPED& ovl) const {
+		if (::ConnectNamedPipe(handle(), &ovl)) {
+			return false;
+		}
+		auto err = GetLastError();
+		if (err == ERROR_PIPE_CONNECTED) {
+			return true;
+		}
+		if (err != ERROR_IO_PENDING) {
+			throw std::system_error(win32_errc(err));
+		}
+		return false;
+	}
+	void Disconnect() const {
+		winapi_call(::DisconnectNamedPipe(handle()));
+	}
+	void SetState(DWORD mode) const {
+		winapi_call(::SetNamedPipeHandleState(handle(), &mode, nullptr, nullptr));
+	}
+};
+
+class NamedPipe : public FileHandle, public OwnableHandle<NamedPipe>, public WaitableHandle<NamedPipe>, public NamedPipeOps<NamedPipe> {
+public:
+	NamedPipe() noexcept : FileHandle(INVALID_HANDLE_VALUE) {}
+	NamedPipe(LPCTSTR name, DWORD openMode, DWORD pipeMode, DWORD maxInstances, DWORD outBuffer, DWORD inBuffer, DWORD timeout, SECURITY_ATTRIBUTES* sattrs)
+		: FileHandle(winapi_call(CreateNamedPipe(name, openMode, pipeMode, maxInstances, outBuffer, inBuffer, timeout, sattrs), CreateFile_error_check)) {}
+	NamedPipe(const tstring& name, DWORD openMode, DWORD pipeMode, DWORD maxInstances = PIPE_UNLIMITED_INSTANCES, DWORD bufferSize = 4096)
+		: NamedPipe(name.c_str(), openMode, pipeMode, maxInstances, bufferSize, bufferSize, 0, nullptr) {}
+};
+
+inline bool WaitNamedPipe(const tstring& name, DWORD timeout) {
+	if (::WaitNamedPipe(name.c_str(), timeout)) {
+		return true;
+	}
+	auto err = GetLastError();
+	if (err == ERROR_SEM_TIMEOUT) {
+		return false;
+	}
+	throw std::system_error(win32_errc(err));
+}
+
+// Message-mode pipe server multiplexing any number of clients onto an
+// IOCompletionPort. A fixed number of instances wait in overlapped
+// ConnectNamedPipe; when one connects another is created, and disconnected
+// instances go back to listening while fewer than twice that number wait.
+// Each connection keeps one read pending and a queue of outgoing messages
+// with one write in flight.
+//
+// Completions are dispatched by the caller's threads: pass every packet from
+// the port to HandleCompletion. Callbacks run on those threads, serialized
+// per connection for messages; Send may be called from anywhere. The
+// destructor waits until all pipes are closed, so completions must keep
+// being dispatched by other threads until it returns.
+class NamedPipeServer {
+public:
+	class Connection {
+	public:
+		Connection(const Connection&) = delete;
+		Connection& operator=(const Connection&) = delete;
+		const NamedPipe& Pipe() const { return pipe; }
+		void* Context() const { return context; }
+		void SetContext(void* context) { this->context = context; }
+		// Queues a copy of message; returns false if the client is gone
+		bool Send(std::span<const std::byte> message) {
+			std::lock_guard lock(mutex);
+			if (state != Connected) {
+				return false;
+			}
+			writeQueue.emplace_back(message.begin(), message.end());
+			if (!writing) {
+				StartWrite();
+			}
+			return true;
+		}
+		void Close() {
+			std::lock_guard lock(mutex);
+			Shutdown();
+		}
+	private:
+		friend class NamedPipeServer;
+		enum State {
+			Listening,
+			Connected,
+			Closing
+		};
+		struct Op : IoOperation {
+			Op(Connection& owner, Completion completion) noexcept : IoOperation(completion), owner(owner) {}
+			Connection& owner;
+		};
+		Connection(NamedPipeServer& server, NamedPipe pipe) :
+			server(server),
+			pipe(std::move(pipe)),
+			connectOp(*this, ConnectDone),
+			readOp(*this, ReadDone),
+			writeOp(*this, WriteDone)
+		{}
+		static void ConnectDone(IoOperation& op, DWORD error, DWORD) {
+			auto& conn = static_cast<Op&>(op).owner;
+			conn.server.OnConnect(conn, error);
+			conn.server.Release(conn);
+		}
+		static void ReadDone(IoOperation& op, DWORD error, DWORD transferred) {
+			auto& conn = static_cast<Op&>(op).owner;
+			conn.server.OnRead(conn, error, transferred);
+			conn.server.Release(conn);
+		}
+		static void WriteDone(IoOperation& op, DWORD error, DWORD) {
+			auto& conn = static_cast<Op&>(op).owner;
+			conn.server.OnWrite(conn, error);
+			conn.server.Release(conn);
+		}
+		static void Reset(Op& op) {
+			static_cast<OVERLAPPED&>(op) = {};
+		}
+		void StartRead() {
+			if (readBuffer.size() - readSize < server.bufferSize) {
+				readBuffer.resize(std::max(readBuffer.size() * 2, readSize + server.bufferSize));
+			}
+			Reset(readOp);
+			++pending;
+			// ERROR_MORE_DATA still queues a completion
+			if (!::ReadFile(pipe, readBuffer.data() + readSize, DWORD(readBuffer.size() - readSize), nullptr, &readOp)) {
+				auto err = GetLastError();
+				if (err != ERROR_IO_PENDING && err != ERROR_MORE_DATA) {
+					--pending;
+					Shutdown();
+				}
+			}
+		}
+		void StartWrite() {
+			auto& message = writeQueue.front();
+			Reset(writeOp);
+			++pending;
+			writing = true;
+			if (!::WriteFile(pipe, message.data(), DWORD(message.size()), nullptr, &writeOp)) {
+				if (GetLastError() != ERROR_IO_PENDING) {
+					--pending;
+					writing = false;
+					Shutdown();
+				}
+			}
+		}
+		void Shutdown() {
+			if (state == Closing) {
+				return;
+			}
+			wasConnected = state == Connected;
+			state = Closing;
+			::CancelIoEx(pipe, nullptr);
+		}
+		NamedPipeServer& server;
+		NamedPipe pipe;
+		Op connectOp;
+		Op readOp;
+		Op writeOp;
+		std::mutex mutex;
+		State state = Listening;
+		bool wasConnected = false;
+		bool writing = false;
+		unsigned pending = 0;
+		std::vector<std::byte> readBuffer;
+		std::size_t readSize = 0;
+		std::deque<std::vector<std::byte>> writeQueue;
+		void* context = nullptr;
+	};
+	struct Callbacks {
+		std::function<void(Connection&)> connected;
+		std::function<void(Connection&, std::span<const std::byte>)> message;
+		std::function<void(Connection&)> disconnected;
+	};
+	template <typename T>
+	NamedPipeServer(const IOCompletionPortHandle<T>& port, ULONG_PTR key, tstring name, Callbacks callbacks,
+		DWORD listeners = 16, DWORD bufferSize = 4096, SECURITY_ATTRIBUTES* sattrs = nullptr) :
+		dispatcher(port, key),
+		name(std::move(name)),
+		callbacks(std::move(callbacks)),
+		listeners(std::max<DWORD>(listeners, 1)),
+		bufferSize(bufferSize),
+		sattrs(sattrs)
+	{
+		// no I/O is issued until every instance has been created
+		std::vector<Connection*> created;
+		for (DWORD i = 0; i < this->listeners; ++i) {
+			created.push_back(CreateInstance());
+		}
+		for (auto conn : created) {
+			Listen(*conn);
+		}
+	}
+	~NamedPipeServer() {
+		Stop();
+		std::unique_lock lock(mutex);
+		drained.wait(lock, [this]{ return connections.empty(); });
+	}
+	NamedPipeServer(const NamedPipeServer&) = delete;
+	NamedPipeServer& operator=(const NamedPipeServer&) = delete;
+	// Returns false if the packet does not belong to this server
+	bool HandleCompletion(const CompletionStatusResult& status) {
+		return dispatcher.HandleCompletion(status);
+	}
+	// Stops accepting and disconnects every client
+	void Stop() {
+		std::lock_guard lock(mutex);
+		stopping = true;
+		for (auto& [ptr, conn] : connections) {
+			std::lock_guard connLock(conn->mutex);
+			conn->Shutdown();
+		}
+	}
+	std::size_t ConnectionCount() const {
+		std::lock_guard lock(mutex);
+		return connections.size() - listening;
+	}
+private:
+	void AddListener() {
+		if (auto conn = CreateInstance()) {
+			Listen(*conn);
+		}
+	}
+	Connection* CreateInstance() {
+		DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED;
+		if (first) {
+			openMode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+			first = false;
+		}
+		NamedPipe pipe(name.c_str(), openMode, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+			PIPE_UNLIMITED_INSTANCES, bufferSize, bufferSize, 0, sattrs);
+		dispatcher.Associate(pipe);
+		auto conn = std::unique_ptr<Connection>(new Connection(*this, std::move(pipe)));
+		auto ptr = conn.get();
+		std::lock_guard lock(mutex);
+		if (stopping) {
+			return nullptr;
+		}
+		connections.emplace(ptr, std::move(conn));
+		return ptr;
+	}
+	void Listen(Connection& conn) {
+		{
+			std::lock_guard lock(mutex);
+			++listening;
+		}
+		bool connected = false;
+		bool failed = false;
+		{
+			std::lock_guard lock(conn.mutex);
+			conn.state = Connection::Listening;
+			conn.wasConnected = false;
+			Connection::Reset(conn.connectOp);
+			++conn.pending;
+			try {
+				connected = conn.pipe.Connect(conn.connectOp);
+			} catch (const std::system_error&) {
+				failed = true;
+			}
+			// Stop may have run before the state changed
+			if (!failed && stopping) {
+				conn.Shutdown();
+			}
+		}
+		if (connected || failed) {
+			OnConnect(conn, failed ? ERROR_PIPE_NOT_CONNECTED : ERROR_SUCCESS);
+			Release(conn);
+		}
+	}
+	void OnConnect(Connection& conn, DWORD error) {
+		bool ok;
+		{
+			std::lock_guard lock(conn.mutex);
+			ok = error == ERROR_SUCCESS && conn.state == Connection::Listening;
+			if (ok) {
+				conn.state = Connection::Connected;
+			} else {
+				conn.Shutdown();
+			}
+		}
+		bool replace;
+		{
+			std::lock_guard lock(mutex);
+			--listening;
+			replace = ok && !stopping && listening < listeners;
+		}
+		if (replace) {
+			try {
+				AddListener();
+			} catch (const std::system_error&) {
+				// keep serving with fewer listeners
+			}
+		}
+		if (!ok) {
+			return;
+		}
+		if (callbacks.connected) {
+			callbacks.connected(conn);
+		}
+		std::lock_guard lock(conn.mutex);
+		if (conn.state == Connection::Connected) {
+			conn.StartRead();
+		}
+	}
+	void OnRead(Connection& conn, DWORD error, DWORD transferred) {
+		if (error != ERROR_SUCCESS && error != ERROR_MORE_DATA) {
+			std::lock_guard lock(conn.mutex);
+			conn.Shutdown();
+			return;
+		}
+		conn.readSize += transferred;
+		if (error == ERROR_SUCCESS) {
+			if (callbacks.message) {
+				callbacks.message(conn, std::span<const std::byte>(conn.readBuffer.data(), conn.readSize));
+			}
+			conn.readSize = 0;
+		}
+		std::lock_guard lock(conn.mutex);
+		if (conn.state == Connection::Connected) {
+			conn.StartRead();
+		}
+	}
+	void OnWrite(Connection& conn, DWORD error) {
+		std::lock_guard lock(conn.mutex);
+		conn.writing = false;
+		conn.writeQueue.pop_front();
+		if (error != ERROR_SUCCESS) {
+			conn.Shutdown();
+		} else if (conn.state == Connection::Connected && !conn.writeQueue.empty()) {
+			conn.StartWrite();
+		}
+	}
+	// Drops the reference of a completed operation and recycles the
+	// connection once it has none left
+	void Release(Connection& conn) {
+		bool notify;
+		{
+			std::lock_guard lock(conn.mutex);
+			if (--conn.pending != 0 || conn.state != Connection::Closing) {
+				return;
+			}
+			notify = conn.wasConnected;
+			conn.writeQueue.clear();
+			conn.readSize = 0;
+			::DisconnectNamedPipe(conn.pipe);
+		}
+		if (notify && callbacks.disconnected) {
+			callbacks.disconnected(conn);
+		}
+		conn.context = nullptr;
+		bool reuse;
+		{
+			std::lock_guard lock(mutex);
+			// instances that never connected are not retried
+			reuse = !stopping && notify && listening < 2 * listeners;
+			if (!reuse) {
+				connections.erase(&conn);
+				if (connections.empty()) {
+					drained.notify_all();
+				}
+				return;
+			}
+		}
+		Listen(conn);
+	}
+	IoDispatcher dispatcher;
+	tstring name;
+	Callbacks callbacks;
+	DWORD listeners;
+	DWORD bufferSize;
+	SECURITY_ATTRIBUTES* sattrs;
+	mutable std::mutex mutex;
+	std::condition_variable drained;
+	std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+	DWORD listening = 0;
+	std::atomic<bool> stopping = false;
+	bool first = true;
+};
+
+}
+
+#endif // SWAL_PIPE_H
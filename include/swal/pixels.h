@@ -0,0 +1,131 @@
+#ifndef SWAL_PIXELS_H
+#define SWAL_PIXELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace swal {
+
+// 32bpp BGRA pixels, alpha is premultiplied (same layout AlphaBlend expects)
+template <typename T>
+struct basic_pixel_view {
+	T* data = nullptr;
+	std::size_t width = 0;
+	std::size_t height = 0;
+	std::size_t stride = 0; // in pixels
+
+	basic_pixel_view() = default;
+	basic_pixel_view(T* data, std::size_t width, std::size_t height, std::size_t stride) :
+		data(data), width(width), height(height), stride(stride) {}
+	basic_pixel_view(T* data, std::size_t width, std::size_t height) :
+		basic_pixel_view(data, width, height, width) {}
+	template <typename U> requires (std::is_convertible_v<U*, T*>)
+	basic_pixel_view(const basic_pixel_view<U>& other) :
+		basic_pixel_view(other.data, other.width, other.height, other.stride) {}
+
+	std::span<T> row(std::size_t y) const { return { data + y * stride, width }; }
+	basic_pixel_view sub(std::size_t x, std::size_t y, std::size_t w, std::size_t h) const {
+		x = std::min(x, width);
+		y = std::min(y, height);
+		return { data + y * stride + x, std::min(w, width - x), std::min(h, height - y), stride };
+	}
+	bool contiguous() const { return stride == width; }
+	bool empty() const { return width == 0 || height == 0; }
+};
+
+using pixel_view = basic_pixel_view<std::uint32_t>;
+using const_pixel_view = basic_pixel_view<const std::uint32_t>;
+
+inline constexpr std::uint32_t Bgra(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a = 255) {
+	return std::uint32_t(b) | std::uint32_t(g) << 8 | std::uint32_t(r) << 16 | std::uint32_t(a) << 24;
+}
+
+// src over dst for premultiplied pixels; both 8-bit channel pairs are scaled
+// at once so the loops below stay branch-free and auto-vectorize
+inline constexpr std::uint32_t blend_pixel(std::uint32_t dst, std::uint32_t src) {
+	std::uint32_t ia = 255 - (src >> 24);
+	std::uint32_t rb = (dst & 0x00FF00FF) * ia + 0x00800080;
+	rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+	std::uint32_t ag = ((dst >> 8) & 0x00FF00FF) * ia + 0x00800080;
+	ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+	return src + (rb | ag);
+}
+
+inline void fill_pixels(std::span<std::uint32_t> dst, std::uint32_t color) {
+	std::fill(dst.begin(), dst.end(), color);
+}
+
+inline void fill_pixels(pixel_view dst, std::uint32_t color) {
+	if (dst.contiguous()) {
+		fill_pixels(std::span(dst.data, dst.width * dst.height), color);
+		return;
+	}
+	for (std::size_t y = 0; y < dst.height; ++y) {
+		fill_pixels(dst.row(y), color);
+	}
+}
+
+inline void fill_pixels(pixel_view dst, std::size_t x, std::size_t y, std::size_t w, std::size_t h, std::uint32_t color) {
+	fill_pixels(dst.sub(x, y, w, h), color);
+}
+
+inline void copy_pixels(std::span<std::uint32_t> dst, std::span<const std::uint32_t> src) {
+	std::copy_n(src.begin(), std::min(dst.size(), src.size()), dst.begin());
+}
+
+inline void copy_pixels(pixel_view dst, const_pixel_view src) {
+	auto height = std::min(dst.height, src.height);
+	if (dst.contiguous() && src.contiguous() && dst.width == src.width) {
+		copy_pixels(std::span(dst.data, dst.width * height), std::span(src.data, src.width * height));
+		return;
+	}
+	for (std::size_t y = 0; y < height; ++y) {
+		copy_pixels(dst.row(y), src.row(y));
+	}
+}
+
+inline void blend_pixels(std::span<std::uint32_t> dst, std::span<const std::uint32_t> src) {
+	auto size = std::min(dst.size(), src.size());
+	auto d = dst.data();
+	auto s = src.data();
+	for (std::size_t i = 0; i < size; ++i) {
+		d[i] = blend_pixel(d[i], s[i]);
+	}
+}
+
+inline void blend_pixels(pixel_view dst, const_pixel_view src) {
+	auto height = std::min(dst.height, src.height);
+	for (std::size_t y = 0; y < height; ++y) {
+		blend_pixels(dst.row(y), src.row(y));
+	}
+}
+
+inline void blend_pixels(std::span<std::uint32_t> dst, std::uint32_t color) {
+	for (auto& d : dst) {
+		d = blend_pixel(d, color);
+	}
+}
+
+inline void blend_pixels(pixel_view dst, std::uint32_t color) {
+	for (std::size_t y = 0; y < dst.height; ++y) {
+		blend_pixels(dst.row(y), color);
+	}
+}
+
+// GDI leaves the alpha byte of 32bpp readbacks zeroed, so the result is made opaque
+inline constexpr std::uint32_t bgra_to_rgba(std::uint32_t px) {
+	return 0xFF000000 | (px & 0x0000FF00) | ((px >> 16) & 0xFF) | ((px & 0xFF) << 16);
+}
+
+inline void convert_bgra_to_rgba(std::span<std::uint32_t> px) {
+	for (auto& p : px) {
+		p = bgra_to_rgba(p);
+	}
+}
+
+}
+
+#endif // SWAL_PIXELS_H
@@ -5,6 +5,14 @@
 #include "zero_or_resource.h"
 #include "enum_bitwise.h"
 #include "strconv.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
 
 namespace swal {
 
@@ -14,6 +22,226 @@ inline DWORD RegOpenKeyEx_error_check(LSTATUS status) {
     return DWORD(status);
 }
 
+struct RegKeyInfo {
+    DWORD subKeys;
+    DWORD maxSubKeyLen;
+    DWORD maxClassLen;
+    DWORD values;
+    DWORD maxValueNameLen;
+    DWORD maxValueLen;
+    DWORD securityDescriptorLen;
+    FILETIME lastWriteTime;
+};
+
+inline DWORD RegEnum_error_check(LSTATUS status) {
+    return (status == ERROR_NO_MORE_ITEMS ? ERROR_SUCCESS : DWORD(status));
+}
+
+// Registry names compare case-insensitively; only ASCII letters are folded
+struct RegNameHash {
+    using is_transparent = void;
+    std::size_t operator()(tstring_view name) const noexcept
+    {
+        std::size_t h = 14695981039346656037ull;
+        for (auto c : name) {
+            h = (h ^ std::size_t(Fold(c))) * 1099511628211ull;
+        }
+        return h;
+    }
+    static TCHAR Fold(TCHAR c) noexcept
+    {
+        return (c >= TEXT('A') && c <= TEXT('Z')) ? TCHAR(c - TEXT('A') + TEXT('a')) : c;
+    }
+};
+
+struct RegNameEqual {
+    using is_transparent = void;
+    bool operator()(tstring_view a, tstring_view b) const noexcept
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            if (RegNameHash::Fold(a[i]) != RegNameHash::Fold(b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct RegNameLess {
+    using is_transparent = void;
+    bool operator()(tstring_view a, tstring_view b) const noexcept
+    {
+        return std::lexicographical_compare(
+            a.begin(), a.end(), b.begin(), b.end(),
+            [](TCHAR x, TCHAR y) { return RegNameHash::Fold(x) < RegNameHash::Fold(y); }
+        );
+    }
+};
+
+// Zero-copy view of a REG_MULTI_SZ value; iterates up to the first empty string
+class RegMultiString {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = tstring_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = tstring_view;
+        iterator() = default;
+        iterator(const TCHAR* pos, const TCHAR* last) : pos(pos), last(last)
+        {
+            Find();
+        }
+        tstring_view operator*() const
+        {
+            return { pos, len };
+        }
+        iterator& operator++()
+        {
+            pos = std::min(pos + len + 1, last);
+            Find();
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+        bool operator==(const iterator& other) const
+        {
+            return pos == other.pos;
+        }
+    private:
+        void Find()
+        {
+            len = std::size_t(std::find(pos, last, TCHAR(0)) - pos);
+            if (len == 0) {
+                pos = last;
+            }
+        }
+        const TCHAR* pos = nullptr;
+        const TCHAR* last = nullptr;
+        std::size_t len = 0;
+    };
+    RegMultiString() = default;
+    RegMultiString(const TCHAR* data, std::size_t size) : first(data), last(data + size)
+    {}
+    iterator begin() const
+    {
+        return { first, last };
+    }
+    iterator end() const
+    {
+        return { last, last };
+    }
+    bool empty() const
+    {
+        return begin() == end();
+    }
+private:
+    const TCHAR* first = nullptr;
+    const TCHAR* last = nullptr;
+};
+
+// Typed view of a value read into a RegBuffer; valid until the buffer is reused
+class RegValueView {
+public:
+    RegValueView(tstring_view name, DWORD type, std::span<const BYTE> data) :
+        name(name), type(type), data(data)
+    {}
+    explicit RegValueView(const VALENT& entry) :
+        RegValueView(
+            entry.ve_valuename,
+            entry.ve_type,
+            { reinterpret_cast<const BYTE*>(entry.ve_valueptr), entry.ve_valuelen }
+        )
+    {}
+    tstring_view Name() const
+    {
+        return name;
+    }
+    DWORD Type() const
+    {
+        return type;
+    }
+    std::span<const BYTE> Data() const
+    {
+        return data;
+    }
+    std::optional<DWORD> AsDWORD() const
+    {
+        return As<DWORD>(REG_DWORD);
+    }
+    std::optional<ULONGLONG> AsQWORD() const
+    {
+        return As<ULONGLONG>(REG_QWORD);
+    }
+    std::optional<tstring_view> AsString() const
+    {
+        if (type != REG_SZ && type != REG_EXPAND_SZ) {
+            return std::nullopt;
+        }
+        tstring_view result = Chars();
+        while (!result.empty() && result.back() == 0) {
+            result.remove_suffix(1);
+        }
+        return result;
+    }
+    std::optional<RegMultiString> AsMultiString() const
+    {
+        if (type != REG_MULTI_SZ) {
+            return std::nullopt;
+        }
+        auto chars = Chars();
+        return RegMultiString(chars.data(), chars.size());
+    }
+    std::optional<std::span<const BYTE>> AsBinary() const
+    {
+        if (type != REG_BINARY) {
+            return std::nullopt;
+        }
+        return data;
+    }
+private:
+    template <typename T>
+    std::optional<T> As(DWORD expected) const
+    {
+        if (type != expected || data.size() < sizeof(T)) {
+            return std::nullopt;
+        }
+        T result;
+        std::memcpy(&result, data.data(), sizeof(T));
+        return result;
+    }
+    tstring_view Chars() const
+    {
+        return { reinterpret_cast<const TCHAR*>(data.data()), data.size() / sizeof(TCHAR) };
+    }
+    tstring_view name;
+    DWORD type;
+    std::span<const BYTE> data;
+};
+
+// Growable name/data buffers reused across enumerations and queries
+struct RegBuffer {
+    std::vector<TCHAR> name;
+    std::vector<BYTE> data;
+    void Reserve(std::size_t nameLen, std::size_t dataLen)
+    {
+        if (name.size() < nameLen) {
+            name.resize(nameLen);
+        }
+        if (data.size() < dataLen) {
+            data.resize(dataLen);
+        }
+    }
+};
+
 class RegKeyHandle : public zero_or_resource<HKEY> {
 public:
     constexpr RegKeyHandle(HKEY hKey) : zero_or_resource(hKey)
@@ -79,6 +307,150 @@ public:
     {
         SetValue(valName.c_str(), REG_SZ, reinterpret_cast<const BYTE*>(value.c_str()), DWORD(value.size() * sizeof(TCHAR)));
     }
+    RegKeyInfo QueryInfo() const
+    {
+        RegKeyInfo info;
+        winapi_call(
+            RegQueryInfoKey(
+                *this, nullptr, nullptr, nullptr,
+                &info.subKeys, &info.maxSubKeyLen, &info.maxClassLen,
+                &info.values, &info.maxValueNameLen, &info.maxValueLen,
+                &info.securityDescriptorLen, &info.lastWriteTime
+            ),
+            RegOpenKeyEx_error_check
+        );
+        return info;
+    }
+    bool EnumKey(DWORD index, LPTSTR name, DWORD* nameLen, FILETIME* lastWriteTime = nullptr) const
+    {
+        return winapi_call(
+            RegEnumKeyEx(*this, index, name, nameLen, nullptr, nullptr, nullptr, lastWriteTime),
+            RegEnum_error_check
+        ) != ERROR_NO_MORE_ITEMS;
+    }
+    bool EnumValue(DWORD index, LPTSTR name, DWORD* nameLen, DWORD* type, BYTE* data, DWORD* size) const
+    {
+        return winapi_call(
+            RegEnumValue(*this, index, name, nameLen, nullptr, type, data, size),
+            RegEnum_error_check
+        ) != ERROR_NO_MORE_ITEMS;
+    }
+    // Calls f(RegValueView) for every value; one syscall per value as the
+    // buffer is pre-sized from RegQueryInfoKey and only grows on a race
+    template <typename F>
+    void ForEachValue(RegBuffer& buffer, F&& f) const
+    {
+        ForEachValue(QueryInfo(), buffer, std::forward<F>(f));
+    }
+    template <typename F>
+    void ForEachValue(RegKeyInfo info, RegBuffer& buffer, F&& f) const
+    {
+        buffer.Reserve(info.maxValueNameLen + 1, std::max<DWORD>(info.maxValueLen, 1));
+        for (DWORD i = 0;;) {
+            DWORD nameLen = DWORD(buffer.name.size());
+            DWORD type;
+            DWORD size = DWORD(buffer.data.size());
+            auto status = RegEnumValue(*this, i, buffer.name.data(), &nameLen, nullptr, &type, buffer.data.data(), &size);
+            if (status == ERROR_NO_MORE_ITEMS) {
+                return;
+            }
+            if (status == ERROR_MORE_DATA) {
+                info = QueryInfo();
+                buffer.Reserve(std::size_t(info.maxValueNameLen) + 1, std::max(info.maxValueLen, size));
+                continue;
+            }
+            winapi_call(status, RegOpenKeyEx_error_check);
+            f(RegValueView({ buffer.name.data(), nameLen }, type, { buffer.data.data(), size }));
+            ++i;
+        }
+    }
+    // Calls f(tstring_view name) for every subkey
+    template <typename F>
+    void ForEachSubKey(RegBuffer& buffer, F&& f) const
+    {
+        ForEachSubKey(QueryInfo(), buffer, std::forward<F>(f));
+    }
+    template <typename F>
+    void ForEachSubKey(RegKeyInfo info, RegBuffer& buffer, F&& f) const
+    {
+        buffer.Reserve(std::size_t(info.maxSubKeyLen) + 1, 0);
+        for (DWORD i = 0;;) {
+            DWORD nameLen = DWORD(buffer.name.size());
+            auto status = RegEnumKeyEx(*this, i, buffer.name.data(), &nameLen, nullptr, nullptr, nullptr, nullptr);
+            if (status == ERROR_NO_MORE_ITEMS) {
+                return;
+            }
+            if (status == ERROR_MORE_DATA) {
+                info = QueryInfo();
+                buffer.Reserve(std::max<std::size_t>(info.maxSubKeyLen, buffer.name.size() * 2) + 1, 0);
+                continue;
+            }
+            winapi_call(status, RegOpenKeyEx_error_check);
+            f(tstring_view(buffer.name.data(), nameLen));
+            ++i;
+        }
+    }
+    std::vector<tstring> GetSubKeyNames() const
+    {
+        RegBuffer buffer;
+        std::vector<tstring> result;
+        ForEachSubKey(buffer, [&](tstring_view name) { result.emplace_back(name); });
+        return result;
+    }
+    // Reads a value in one call when the buffer is already large enough
+    RegValueView QueryValue(LPCTSTR valName, RegBuffer& buffer) const
+    {
+        if (buffer.data.empty()) {
+            buffer.data.resize(256);
+        }
+        for (;;) {
+            DWORD type;
+            DWORD size = DWORD(buffer.data.size());
+            auto status = RegQueryValueEx(*this, valName, nullptr, &type, buffer.data.data(), &size);
+            if (status == ERROR_MORE_DATA) {
+                buffer.data.resize(size);
+                continue;
+            }
+            winapi_call(status, RegOpenKeyEx_error_check);
+            return { valName ? tstring_view(valName) : tstring_view(), type, { buffer.data.data(), size } };
+        }
+    }
+    tstring QueryString(const tstring& valName) const
+    {
+        RegBuffer buffer;
+        auto result = QueryValue(valName.c_str(), buffer).AsString();
+        if (!result) {
+            throw std::system_error(win32_errc(ERROR_DATATYPE_MISMATCH));
+        }
+        return tstring(*result);
+    }
+    // Fills entries' ve_valuelen/ve_valueptr/ve_type with data stored in buffer
+    void QueryMultipleValues(std::span<VALENT> entries, std::vector<BYTE>& buffer) const
+    {
+        if (buffer.empty()) {
+            buffer.resize(256);
+        }
+        for (;;) {
+            DWORD size = DWORD(buffer.size());
+            auto status = RegQueryMultipleValues(
+                *this, entries.data(), DWORD(entries.size()),
+                reinterpret_cast<LPTSTR>(buffer.data()), &size
+            );
+            if (status == ERROR_MORE_DATA) {
+                buffer.resize(size);
+                continue;
+            }
+            winapi_call(status, RegOpenKeyEx_error_check);
+            return;
+        }
+    }
+    void NotifyChange(bool watchSubtree, DWORD filter, HANDLE event, bool async) const
+    {
+        winapi_call(
+            RegNotifyChangeKeyValue(*this, watchSubtree, filter, event, async),
+            RegOpenKeyEx_error_check
+        );
+    }
     void DeleteValue(LPCTSTR valName)
     {
         winapi_call(RegDeleteValue(*this, valName), RegOpenKeyEx_error_check);
@@ -0,0 +1,191 @@
+#ifndef SWAL_REG_CACHE_H
+#define SWAL_REG_CACHE_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "handle.h"
+#include "reg.h"
+#include "strconv.h"
+
+namespace swal {
+
+// In-memory copy of a registry subtree. Reads go to an immutable snapshot
+// published through an atomic shared_ptr, so a read never takes the cache's
+// lock or enters the kernel, and a reload swaps in the next snapshot while
+// readers that still hold the old one finish with it. A background thread
+// waits for RegNotifyChangeKeyValue and reloads. The notification does not
+// say which key changed, so a reload opens and queries every key in the
+// subtree; values are re-read only for keys whose last write time changed.
+// Keep cached subtrees small.
+class RegistryCache {
+public:
+	struct Value {
+		DWORD type;
+		std::vector<BYTE> data;
+	};
+	struct Key {
+		FILETIME lastWriteTime;
+		std::unordered_map<tstring, Value, RegNameHash, RegNameEqual> values;
+		std::vector<tstring> subKeys;
+	};
+	struct Snapshot {
+		std::unordered_map<tstring, std::shared_ptr<const Key>, RegNameHash, RegNameEqual> keys;
+		std::size_t generation = 0;
+		const Value* Find(tstring_view path, tstring_view name) const {
+			auto key = keys.find(path);
+			if (key == keys.end()) {
+				return nullptr;
+			}
+			auto value = key->second->values.find(name);
+			return (value != key->second->values.end() ? &value->second : nullptr);
+		}
+	};
+#if _WIN32_WINNT >= 0x0602
+	static constexpr DWORD NotifyFilter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC;
+#else
+	static constexpr DWORD NotifyFilter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET;
+#endif
+	RegistryCache(const RegKeyHandle& root, const tstring& path, REGSAM sam = KEY_READ) :
+		sam(sam),
+		key(root.OpenKey(path, sam | KEY_NOTIFY)),
+		changed(false, false),
+		stop(true, false)
+	{
+		key.NotifyChange(true, NotifyFilter, changed, true);
+		Reload();
+		thread = std::thread([this]{ Run(); });
+	}
+	~RegistryCache() {
+		stop.Set();
+		thread.join();
+	}
+	RegistryCache(const RegistryCache&) = delete;
+	RegistryCache& operator=(const RegistryCache&) = delete;
+	// Pins the current snapshot for a series of consistent reads
+	std::shared_ptr<const Snapshot> GetSnapshot() const {
+		return latest.load(std::memory_order_acquire);
+	}
+	std::optional<DWORD> GetDWORD(tstring_view path, tstring_view name) const {
+		auto snapshot = GetSnapshot();
+		auto value = snapshot->Find(path, name);
+		if (!value || value->type != REG_DWORD || value->data.size() < sizeof(DWORD)) {
+			return std::nullopt;
+		}
+		DWORD result;
+		std::memcpy(&result, value->data.data(), sizeof(result));
+		return result;
+	}
+	std::optional<ULONGLONG> GetQWORD(tstring_view path, tstring_view name) const {
+		auto snapshot = GetSnapshot();
+		auto value = snapshot->Find(path, name);
+		if (!value || value->type != REG_QWORD || value->data.size() < sizeof(ULONGLONG)) {
+			return std::nullopt;
+		}
+		ULONGLONG result;
+		std::memcpy(&result, value->data.data(), sizeof(result));
+		return result;
+	}
+	std::optional<tstring> GetString(tstring_view path, tstring_view name) const {
+		auto snapshot = GetSnapshot();
+		auto value = GetString(*snapshot, path, name);
+		return value ? std::optional<tstring>(*value) : std::nullopt;
+	}
+	// Reads a string without copying it; the view stays valid as long as
+	// the caller keeps the snapshot pinned
+	static std::optional<tstring_view> GetString(const Snapshot& snapshot, tstring_view path, tstring_view name) {
+		auto value = snapshot.Find(path, name);
+		if (!value || (value->type != REG_SZ && value->type != REG_EXPAND_SZ)) {
+			return std::nullopt;
+		}
+		tstring_view result(reinterpret_cast<const TCHAR*>(value->data.data()), value->data.size() / sizeof(TCHAR));
+		while (!result.empty() && result.back() == 0) {
+			result.remove_suffix(1);
+		}
+		return result;
+	}
+	// Synchronously brings the snapshot up to date
+	void Reload() {
+		std::lock_guard reloading(reloadMutex);
+		auto old = GetSnapshot();
+		auto next = std::make_shared<Snapshot>();
+		next->generation = old ? old->generation + 1 : 0;
+		RegBuffer buffer;
+		Load(key, tstring(), old.get(), *next, buffer);
+		latest.store(std::move(next), std::memory_order_release);
+	}
+private:
+	void Load(const RegKeyHandle& handle, const tstring& path, const Snapshot* old, Snapshot& out, RegBuffer& buffer) {
+		auto info = handle.QueryInfo();
+		std::shared_ptr<const Key> data;
+		if (old) {
+			auto it = old->keys.find(path);
+			if (it != old->keys.end() && CompareFileTime(&it->second->lastWriteTime, &info.lastWriteTime) == 0) {
+				data = it->second;
+			}
+		}
+		if (!data) {
+			data = ReadKey(handle, info, buffer);
+		}
+		out.keys.emplace(path, data);
+		for (auto& name : data->subKeys) {
+			std::optional<RegistryKey> sub;
+			try {
+				sub.emplace(handle.OpenKey(name, sam));
+			} catch (const std::system_error&) {
+				// deleted or inaccessible since it was enumerated
+				continue;
+			}
+			Load(*sub, path.empty() ? name : path + TEXT('\\') + name, old, out, buffer);
+		}
+	}
+	std::shared_ptr<const Key> ReadKey(const RegKeyHandle& handle, const RegKeyInfo& info, RegBuffer& buffer) {
+		auto data = std::make_shared<Key>();
+		data->lastWriteTime = info.lastWriteTime;
+		data->values.reserve(info.values);
+		handle.ForEachValue(info, buffer, [&](const RegValueView& value) {
+			data->values.emplace(value.Name(), Value{ value.Type(), { value.Data().begin(), value.Data().end() } });
+		});
+		data->subKeys.reserve(info.subKeys);
+		handle.ForEachSubKey(info, buffer, [&](tstring_view name) {
+			data->subKeys.emplace_back(name);
+		});
+		return data;
+	}
+	void Run() noexcept {
+		HANDLE handles[] = { stop, changed };
+		for (;;) {
+			auto result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+			if (result != WAIT_OBJECT_0 + 1) {
+				return;
+			}
+			try {
+				key.NotifyChange(true, NotifyFilter, changed, true);
+				Reload();
+			} catch (...) {
+				// keep serving the last snapshot
+			}
+		}
+	}
+	REGSAM sam;
+	RegistryKey key;
+	Event changed;
+	Event stop;
+	std::mutex reloadMutex;
+	std::atomic<std::shared_ptr<const Snapshot>> latest;
+	std::thread thread;
+};
+
+}
+
+#endif // SWAL_REG_CACHE_H
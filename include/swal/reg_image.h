@@ -0,0 +1,359 @@
+#ifndef SWAL_REG_IMAGE_H
+#define SWAL_REG_IMAGE_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "handle.h"
+#include "reg.h"
+#include "strconv.h"
+
+namespace swal {
+
+// Layout of a registry image: header, keys sorted by path, values of each key
+// sorted by name, string table, value data. Offsets are bytes from the start
+// of the image; names compare with RegNameLess.
+struct RegImageHeader {
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t charSize;
+	std::uint32_t keyCount;
+	std::uint32_t valueCount;
+	std::uint32_t keysOffset;
+	std::uint32_t valuesOffset;
+	std::uint32_t size;
+	static constexpr std::uint32_t Magic = 0x49525753; // "SWRI"
+	static constexpr std::uint32_t Version = 1;
+};
+
+struct RegImageKey {
+	std::uint32_t path;
+	std::uint32_t pathLen;
+	std::uint32_t lastWriteLow;
+	std::uint32_t lastWriteHigh;
+	std::uint32_t firstValue;
+	std::uint32_t valueCount;
+};
+
+struct RegImageValue {
+	std::uint32_t name;
+	std::uint32_t nameLen;
+	std::uint32_t type;
+	std::uint32_t data;
+	std::uint32_t dataSize;
+};
+
+// Walks the subtree under root and serializes it into an image
+inline std::vector<std::byte> ExportRegistryImage(const RegKeyHandle& root, REGSAM sam = KEY_READ) {
+	struct PendingValue {
+		tstring name;
+		DWORD type;
+		std::vector<BYTE> data;
+	};
+	struct PendingKey {
+		tstring path;
+		FILETIME lastWriteTime;
+		std::vector<PendingValue> values;
+	};
+	std::vector<PendingKey> keys;
+	RegBuffer buffer;
+	auto walk = [&](auto& self, const RegKeyHandle& key, const tstring& path) -> void {
+		auto info = key.QueryInfo();
+		PendingKey pending{ path, info.lastWriteTime, {} };
+		pending.values.reserve(info.values);
+		key.ForEachValue(info, buffer, [&](const RegValueView& value) {
+			pending.values.push_back({ tstring(value.Name()), value.Type(), { value.Data().begin(), value.Data().end() } });
+		});
+		std::sort(pending.values.begin(), pending.values.end(), [](auto& a, auto& b) { return RegNameLess()(a.name, b.name); });
+		keys.push_back(std::move(pending));
+		std::vector<tstring> subKeys;
+		key.ForEachSubKey(info, buffer, [&](tstring_view name) { subKeys.emplace_back(name); });
+		for (auto& name : subKeys) {
+			std::optional<RegistryKey> sub;
+			try {
+				sub.emplace(key.OpenKey(name, sam));
+			} catch (const std::system_error&) {
+				continue;
+			}
+			self(self, *sub, path.empty() ? name : path + TEXT('\\') + name);
+		}
+	};
+	walk(walk, root, tstring());
+	std::sort(keys.begin(), keys.end(), [](auto& a, auto& b) { return RegNameLess()(a.path, b.path); });
+
+	std::size_t valueCount = 0;
+	for (auto& key : keys) {
+		valueCount += key.values.size();
+	}
+	std::vector<RegImageKey> keyRecords;
+	std::vector<RegImageValue> valueRecords;
+	std::vector<TCHAR> strings;
+	std::vector<BYTE> data;
+	keyRecords.reserve(keys.size());
+	valueRecords.reserve(valueCount);
+	std::unordered_map<tstring, std::uint32_t> stringIndex;
+	auto addString = [&](const tstring& str) {
+		auto [it, inserted] = stringIndex.try_emplace(str, std::uint32_t(strings.size()));
+		if (inserted) {
+			strings.insert(strings.end(), str.begin(), str.end());
+		}
+		return it->second;
+	};
+	for (auto& key : keys) {
+		RegImageKey record;
+		record.path = addString(key.path);
+		record.pathLen = std::uint32_t(key.path.size());
+		record.lastWriteLow = key.lastWriteTime.dwLowDateTime;
+		record.lastWriteHigh = key.lastWriteTime.dwHighDateTime;
+		record.firstValue = std::uint32_t(valueRecords.size());
+		record.valueCount = std::uint32_t(key.values.size());
+		keyRecords.push_back(record);
+		for (auto& value : key.values) {
+			RegImageValue valueRecord;
+			valueRecord.name = addString(value.name);
+			valueRecord.nameLen = std::uint32_t(value.name.size());
+			valueRecord.type = value.type;
+			valueRecord.data = std::uint32_t(data.size());
+			valueRecord.dataSize = std::uint32_t(value.data.size());
+			data.insert(data.end(), value.data.begin(), value.data.end());
+			valueRecords.push_back(valueRecord);
+		}
+	}
+
+	RegImageHeader header;
+	header.magic = RegImageHeader::Magic;
+	header.version = RegImageHeader::Version;
+	header.charSize = sizeof(TCHAR);
+	header.keyCount = std::uint32_t(keyRecords.size());
+	header.valueCount = std::uint32_t(valueRecords.size());
+	header.keysOffset = sizeof(RegImageHeader);
+	header.valuesOffset = std::uint32_t(header.keysOffset + keyRecords.size() * sizeof(RegImageKey));
+	std::uint32_t stringsOffset = std::uint32_t(header.valuesOffset + valueRecords.size() * sizeof(RegImageValue));
+	std::uint32_t dataOffset = std::uint32_t(stringsOffset + strings.size() * sizeof(TCHAR));
+	header.size = std::uint32_t(dataOffset + data.size());
+	for (auto& key : keyRecords) {
+		key.path = std::uint32_t(stringsOffset + key.path * sizeof(TCHAR));
+	}
+	for (auto& value : valueRecords) {
+		value.name = std::uint32_t(stringsOffset + value.name * sizeof(TCHAR));
+		value.data += dataOffset;
+	}
+
+	std::vector<std::byte> image(header.size);
+	auto put = [&](std::uint32_t offset, const void* src, std::size_t size) {
+		if (size != 0) {
+			std::memcpy(image.data() + offset, src, size);
+		}
+	};
+	put(0, &header, sizeof(header));
+	put(header.keysOffset, keyRecords.data(), keyRecords.size() * sizeof(RegImageKey));
+	put(header.valuesOffset, valueRecords.data(), valueRecords.size() * sizeof(RegImageValue));
+	put(stringsOffset, strings.data(), strings.size() * sizeof(TCHAR));
+	put(dataOffset, data.data(), data.size());
+	return image;
+}
+
+inline void SaveRegistryImage(const tstring& fileName, const RegKeyHandle& root, REGSAM sam = KEY_READ) {
+	auto image = ExportRegistryImage(root, sam);
+	File file(fileName, GENERIC_WRITE, ShareMode::Zero, CreateMode::CreateAlways, FILE_ATTRIBUTE_NORMAL);
+	file.Write(image.data(), DWORD(image.size()));
+}
+
+// Read-only view of an image, either over caller-provided memory or a mapped
+// file. The image is validated once on construction; lookups are binary
+// searches that return views into it.
+class RegistryImage {
+public:
+	explicit RegistryImage(std::span<const std::byte> image) : image(image) {
+		Validate();
+	}
+	explicit RegistryImage(const tstring& fileName) {
+		File file(fileName, GENERIC_READ, ShareMode::Read, CreateMode::OpenExisting, FILE_ATTRIBUTE_NORMAL);
+		auto size = file.GetSizeEx().QuadPart;
+		if (size < LONGLONG(sizeof(RegImageHeader))) {
+			throw std::system_error(win32_errc(ERROR_BAD_FORMAT));
+		}
+		FileMapping mapping(file, PAGE_READONLY);
+		view = mapping.Map(FILE_MAP_READ);
+		image = { view.As<const std::byte>(), std::size_t(size) };
+		Validate();
+	}
+	std::size_t KeyCount() const { return keys.size(); }
+	std::optional<std::size_t> FindKey(tstring_view path) const {
+		auto it = std::lower_bound(keys.begin(), keys.end(), path, [&](const RegImageKey& key, tstring_view p) {
+			return RegNameLess()(String(key.path, key.pathLen), p);
+		});
+		if (it == keys.end() || !RegNameEqual()(String(it->path, it->pathLen), path)) {
+			return std::nullopt;
+		}
+		return std::size_t(it - keys.begin());
+	}
+	FILETIME KeyLastWriteTime(std::size_t key) const {
+		return { keys[key].lastWriteLow, keys[key].lastWriteHigh };
+	}
+	std::optional<RegValueView> FindValue(std::size_t key, tstring_view name) const {
+		auto first = values.begin() + keys[key].firstValue;
+		auto last = first + keys[key].valueCount;
+		auto it = std::lower_bound(first, last, name, [&](const RegImageValue& value, tstring_view n) {
+			return RegNameLess()(String(value.name, value.nameLen), n);
+		});
+		if (it == last || !RegNameEqual()(String(it->name, it->nameLen), name)) {
+			return std::nullopt;
+		}
+		return View(*it);
+	}
+	std::optional<RegValueView> FindValue(tstring_view path, tstring_view name) const {
+		auto key = FindKey(path);
+		if (!key) {
+			return std::nullopt;
+		}
+		return FindValue(*key, name);
+	}
+	template <typename F>
+	void ForEachValue(std::size_t key, F&& f) const {
+		auto first = values.begin() + keys[key].firstValue;
+		for (auto it = first; it != first + keys[key].valueCount; ++it) {
+			f(View(*it));
+		}
+	}
+private:
+	RegValueView View(const RegImageValue& value) const {
+		return {
+			String(value.name, value.nameLen),
+			value.type,
+			{ reinterpret_cast<const BYTE*>(image.data() + value.data), value.dataSize }
+		};
+	}
+	tstring_view String(std::uint32_t offset, std::uint32_t len) const {
+		return { reinterpret_cast<const TCHAR*>(image.data() + offset), len };
+	}
+	void Validate() {
+		auto bad = []{ throw std::system_error(win32_errc(ERROR_BAD_FORMAT)); };
+		if (image.size() < sizeof(RegImageHeader) || reinterpret_cast<std::uintptr_t>(image.data()) % alignof(RegImageKey) != 0) {
+			bad();
+		}
+		RegImageHeader header;
+		std::memcpy(&header, image.data(), sizeof(header));
+		auto fits = [&](std::uint64_t offset, std::uint64_t size) {
+			return offset + size <= header.size;
+		};
+		if (header.magic != RegImageHeader::Magic || header.version != RegImageHeader::Version ||
+			header.charSize != sizeof(TCHAR) || header.size > image.size() ||
+			!fits(header.keysOffset, std::uint64_t(header.keyCount) * sizeof(RegImageKey)) ||
+			!fits(header.valuesOffset, std::uint64_t(header.valueCount) * sizeof(RegImageValue)) ||
+			header.keysOffset % alignof(RegImageKey) != 0 || header.valuesOffset % alignof(RegImageValue) != 0)
+		{
+			bad();
+		}
+		keys = { reinterpret_cast<const RegImageKey*>(image.data() + header.keysOffset), header.keyCount };
+		values = { reinterpret_cast<const RegImageValue*>(image.data() + header.valuesOffset), header.valueCount };
+		for (auto& key : keys) {
+			if (!fits(key.path, std::uint64_t(key.pathLen) * sizeof(TCHAR)) || key.path % alignof(TCHAR) != 0 ||
+				std::uint64_t(key.firstValue) + key.valueCount > header.valueCount)
+			{
+				bad();
+			}
+		}
+		for (auto& value : values) {
+			if (!fits(value.name, std::uint64_t(value.nameLen) * sizeof(TCHAR)) || value.name % alignof(TCHAR) != 0 ||
+				!fits(value.data, value.dataSize))
+			{
+				bad();
+			}
+		}
+	}
+	MappedView view;
+	std::span<const std::byte> image;
+	std::span<const RegImageKey> keys;
+	std::span<const RegImageValue> values;
+};
+
+// Serves reads from an image while the corresponding live key is unchanged.
+// Each key's last write time is checked against the live registry the first
+// time it is used; values of stale or unknown keys are read live.
+class ImageBackedRegistry {
+public:
+	ImageBackedRegistry(RegistryImage image, const RegKeyHandle& root, const tstring& path, REGSAM sam = KEY_READ) :
+		image(std::move(image)),
+		sam(sam),
+		base(root.OpenKey(path, sam)),
+		states(std::make_unique<std::atomic<std::uint8_t>[]>(this->image.KeyCount()))
+	{}
+	std::optional<DWORD> GetDWORD(tstring_view path, tstring_view name) const {
+		return Read(path, name, [](const RegValueView& value) { return value.AsDWORD(); });
+	}
+	std::optional<ULONGLONG> GetQWORD(tstring_view path, tstring_view name) const {
+		return Read(path, name, [](const RegValueView& value) { return value.AsQWORD(); });
+	}
+	std::optional<tstring> GetString(tstring_view path, tstring_view name) const {
+		return Read(path, name, [](const RegValueView& value) -> std::optional<tstring> {
+			auto str = value.AsString();
+			return str ? std::optional<tstring>(tstring(*str)) : std::nullopt;
+		});
+	}
+	bool IsFresh(tstring_view path) const {
+		auto key = image.FindKey(path);
+		return key && IsFresh(*key, path);
+	}
+	const RegistryImage& Image() const { return image; }
+private:
+	enum State : std::uint8_t {
+		Unknown,
+		Fresh,
+		Stale
+	};
+	bool IsFresh(std::size_t key, tstring_view path) const {
+		auto state = states[key].load(std::memory_order_acquire);
+		if (state == Unknown) {
+			state = Stale;
+			try {
+				auto live = OpenLive(path).QueryInfo().lastWriteTime;
+				auto cached = image.KeyLastWriteTime(key);
+				if (CompareFileTime(&live, &cached) == 0) {
+					state = Fresh;
+				}
+			} catch (const std::system_error&) {
+			}
+			states[key].store(state, std::memory_order_release);
+		}
+		return state == Fresh;
+	}
+	RegistryKey OpenLive(tstring_view path) const {
+		return base.OpenKey(tstring(path), sam);
+	}
+	template <typename F>
+	auto Read(tstring_view path, tstring_view name, F&& convert) const -> decltype(convert(std::declval<RegValueView>())) {
+		auto key = image.FindKey(path);
+		if (key && IsFresh(*key, path)) {
+			auto value = image.FindValue(*key, name);
+			if (!value) {
+				return std::nullopt;
+			}
+			return convert(*value);
+		}
+		try {
+			RegBuffer buffer;
+			tstring valName(name);
+			return convert(OpenLive(path).QueryValue(valName.c_str(), buffer));
+		} catch (const std::system_error&) {
+			return std::nullopt;
+		}
+	}
+	RegistryImage image;
+	REGSAM sam;
+	RegistryKey base;
+	std::unique_ptr<std::atomic<std::uint8_t>[]> states;
+};
+
+}
+
+#endif // SWAL_REG_IMAGE_H
@@ -0,0 +1,248 @@
+#ifndef SWAL_SHARED_RING_H
+#define SWAL_SHARED_RING_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include "error.h"
+#include "handle.h"
+#include "strconv.h"
+
+namespace swal {
+
+// Control block at the start of a shared ring's mapping. The indices are
+// free-running byte positions; each lives on its own cache line.
+struct SharedRingHeader {
+	static constexpr std::uint32_t Magic = 0x474E5253; // "SRNG"
+	static constexpr std::uint32_t Version = 1;
+	std::atomic<std::uint32_t> state;
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t multiProducer;
+	std::uint64_t capacity;
+	alignas(64) std::atomic<std::uint64_t> head;
+	alignas(64) std::atomic<std::uint64_t> tail;
+	alignas(64) std::atomic<std::uint32_t> consumerWaiting;
+	alignas(64) std::atomic<std::uint32_t> producersWaiting;
+};
+
+// Message ring in a named pagefile-backed mapping, shared between processes
+// that open it by name. Messages are length-prefixed records written once
+// into the ring by the producer and handed to the consumer in place. Blocking
+// calls spin first and then sleep on a named auto-reset event, which the
+// other side only sets when someone is actually waiting.
+//
+// With MultiProducer any number of writers reserve space with a CAS and
+// publish their record with a commit bit; the single reader zeroes consumed
+// space so that a stale header is never mistaken for a committed one.
+template <bool MultiProducer>
+class BasicSharedRing {
+public:
+	static constexpr std::size_t MinCapacity = 64;
+	// Creates the ring, or opens it if it already exists, in which case the
+	// existing capacity is kept
+	BasicSharedRing(const tstring& name, std::size_t capacity) :
+		mapping(name, PAGE_READWRITE, sizeof(SharedRingHeader) + std::bit_ceil(std::max(capacity, MinCapacity))),
+		view(mapping.Map(FILE_MAP_READ | FILE_MAP_WRITE)),
+		dataEvent(nullptr, false, false, (name + TEXT(".data")).c_str()),
+		spaceEvent(nullptr, false, false, (name + TEXT(".space")).c_str())
+	{
+		Attach(std::bit_ceil(std::max(capacity, MinCapacity)));
+	}
+	// Opens an existing ring
+	explicit BasicSharedRing(const tstring& name) :
+		mapping(FILE_MAP_READ | FILE_MAP_WRITE, false, name),
+		view(mapping.Map(FILE_MAP_READ | FILE_MAP_WRITE)),
+		dataEvent(nullptr, false, false, (name + TEXT(".data")).c_str()),
+		spaceEvent(nullptr, false, false, (name + TEXT(".space")).c_str())
+	{
+		Attach(0);
+	}
+	std::size_t Capacity() const noexcept { return mask + 1; }
+	std::size_t MaxMessageSize() const noexcept { return Capacity() / 2 - RecordHeader; }
+	void SetSpinCount(unsigned count) noexcept { spinCount = count; }
+	bool TryWrite(std::span<const std::byte> message) {
+		if (message.size() > MaxMessageSize()) {
+			throw std::system_error(win32_errc(ERROR_INVALID_PARAMETER));
+		}
+		auto need = RecordSize(message.size());
+		std::uint64_t pos, skip;
+		for (;;) {
+			// head is read after tail so it is never behind it
+			auto tail = header->tail.load(std::memory_order_acquire);
+			pos = header->head.load(std::memory_order_relaxed);
+			skip = Skip(pos, need);
+			if (pos + skip + need - tail > Capacity()) {
+				return false;
+			}
+			if constexpr (!MultiProducer) {
+				break;
+			} else if (header->head.compare_exchange_weak(pos, pos + skip + need, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+		if (skip != 0) {
+			Commit(pos, Padding | (skip - RecordHeader));
+		}
+		auto at = pos + skip;
+		if (!message.empty()) {
+			std::memcpy(data + ((at + RecordHeader) & mask), message.data(), message.size());
+		}
+		Commit(at, message.size());
+		if constexpr (!MultiProducer) {
+			header->head.store(at + need, std::memory_order_seq_cst);
+		}
+		if (header->consumerWaiting.load(std::memory_order_seq_cst) != 0) {
+			::SetEvent(dataEvent);
+		}
+		return true;
+	}
+	bool Write(std::span<const std::byte> message, DWORD timeout = INFINITE) {
+		return Wait([&]{ return TryWrite(message); }, header->producersWaiting, spaceEvent, timeout);
+	}
+	// Calls f(std::span<const std::byte>) with the next message, which is
+	// only valid during the call; returns false if the ring is empty. If f
+	// throws, the message is left in the ring.
+	template <typename F>
+	bool TryRead(F&& f) {
+		auto pos = header->tail.load(std::memory_order_relaxed);
+		for (;;) {
+			if constexpr (!MultiProducer) {
+				if (pos == header->head.load(std::memory_order_seq_cst)) {
+					return false;
+				}
+			}
+			auto word = Word(pos).load(std::memory_order_seq_cst);
+			if (!(word & Committed)) {
+				return false;
+			}
+			auto length = std::size_t(word & LengthMask);
+			auto size = RecordSize(length);
+			if (!(word & Padding)) {
+				f(std::span<const std::byte>(data + ((pos + RecordHeader) & mask), length));
+				Consume(pos, size);
+				return true;
+			}
+			Consume(pos, size);
+			pos += size;
+		}
+	}
+	template <typename F>
+	bool Read(F&& f, DWORD timeout = INFINITE) {
+		return Wait([&]{ return TryRead(f); }, header->consumerWaiting, dataEvent, timeout);
+	}
+private:
+	static constexpr std::size_t RecordHeader = sizeof(std::uint64_t);
+	static constexpr std::uint64_t LengthMask = 0xFFFFFFFF;
+	static constexpr std::uint64_t Committed = std::uint64_t(1) << 32;
+	static constexpr std::uint64_t Padding = std::uint64_t(1) << 33;
+	void Attach(std::size_t initial) {
+		header = view.As<SharedRingHeader>();
+		data = reinterpret_cast<std::byte*>(header + 1);
+		std::uint32_t expected = 0;
+		if (initial != 0 && header->state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+			header->magic = SharedRingHeader::Magic;
+			header->version = SharedRingHeader::Version;
+			header->multiProducer = MultiProducer;
+			header->capacity = initial;
+			header->state.store(2, std::memory_order_release);
+		} else {
+			// another process is initializing the header
+			for (unsigned i = 0; header->state.load(std::memory_order_acquire) != 2; ++i) {
+				if (i == 1000) {
+					throw std::system_error(win32_errc(ERROR_INVALID_DATA));
+				}
+				::Sleep(1);
+			}
+		}
+		// the header is shared, so the capacity is read once and must fit
+		// in what this process actually mapped
+		auto capacity = header->capacity;
+		auto viewSize = view.Size();
+		if (header->magic != SharedRingHeader::Magic || header->version != SharedRingHeader::Version ||
+			header->multiProducer != MultiProducer || !std::has_single_bit(capacity) ||
+			capacity < MinCapacity || viewSize < sizeof(SharedRingHeader) ||
+			capacity > viewSize - sizeof(SharedRingHeader))
+		{
+			throw std::system_error(win32_errc(ERROR_INVALID_DATA));
+		}
+		mask = std::size_t(capacity - 1);
+	}
+	static std::size_t RecordSize(std::size_t length) noexcept {
+		return RecordHeader + ((length + RecordHeader - 1) & ~(RecordHeader - 1));
+	}
+	// bytes of padding needed so that a record does not wrap
+	std::uint64_t Skip(std::uint64_t pos, std::size_t need) const noexcept {
+		auto gap = Capacity() - (pos & mask);
+		return gap < need ? gap : 0;
+	}
+	std::atomic_ref<std::uint64_t> Word(std::uint64_t pos) const noexcept {
+		return std::atomic_ref(*reinterpret_cast<std::uint64_t*>(data + (pos & mask)));
+	}
+	void Commit(std::uint64_t pos, std::uint64_t word) noexcept {
+		Word(pos).store(word | Committed, std::memory_order_seq_cst);
+	}
+	void Consume(std::uint64_t pos, std::size_t size) noexcept {
+		if constexpr (MultiProducer) {
+			std::memset(data + (pos & mask), 0, size);
+		}
+		header->tail.store(pos + size, std::memory_order_seq_cst);
+		if (header->producersWaiting.load(std::memory_order_seq_cst) != 0) {
+			::SetEvent(spaceEvent);
+		}
+	}
+	template <typename F>
+	bool Wait(F&& attempt, std::atomic<std::uint32_t>& waiters, const Event& event, DWORD timeout) {
+		for (unsigned i = 0; i < spinCount; ++i) {
+			if (attempt()) {
+				return true;
+			}
+			YieldProcessor();
+		}
+		auto deadline = ::GetTickCount64() + timeout;
+		for (;;) {
+			waiters.fetch_add(1, std::memory_order_seq_cst);
+			bool done = false;
+			DWORD result = WAIT_OBJECT_0;
+			try {
+				done = attempt();
+				if (!done) {
+					auto now = ::GetTickCount64();
+					auto wait = timeout == INFINITE ? INFINITE : now < deadline ? DWORD(deadline - now) : 0;
+					result = event.WaitFor(wait);
+				}
+			} catch (...) {
+				waiters.fetch_sub(1, std::memory_order_relaxed);
+				throw;
+			}
+			waiters.fetch_sub(1, std::memory_order_relaxed);
+			if (done) {
+				return true;
+			}
+			if (result == WAIT_TIMEOUT) {
+				return attempt();
+			}
+		}
+	}
+	FileMapping mapping;
+	MappedView view;
+	Event dataEvent;
+	Event spaceEvent;
+	SharedRingHeader* header = nullptr;
+	std::byte* data = nullptr;
+	std::size_t mask = 0;
+	unsigned spinCount = 4000;
+};
+
+using SpscRing = BasicSharedRing<false>;
+using MpscRing = BasicSharedRing<true>;
+
+}
+
+#endif // SWAL_SHARED_RING_H
@@ -0,0 +1,587 @@
+#ifndef SWAL_SOCKET_H
+#define SWAL_SOCKET_H
+
+#include "win_headers.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "error.h"
+#include "handle.h"
+
+namespace swal {
+
+inline DWORD socket_error_check(int result) {
+	return (result != SOCKET_ERROR ? ERROR_SUCCESS : DWORD(::WSAGetLastError()));
+}
+
+inline DWORD socket_create_error_check(SOCKET result) {
+	return (result != INVALID_SOCKET ? ERROR_SUCCESS : DWORD(::WSAGetLastError()));
+}
+
+struct WSAInitializer
+{
+    WSAInitializer(WORD version = MAKEWORD(2, 2))
+    {
+        WSADATA data;
+        if (auto err = ::WSAStartup(version, &data)) {
+            throw std::system_error(win32_errc(err));
+        }
+    }
+    ~WSAInitializer()
+    {
+        ::WSACleanup();
+    }
+    WSAInitializer(const WSAInitializer&) = delete;
+    WSAInitializer& operator=(const WSAInitializer&) = delete;
+};
+
+// Extension functions are looked up once, from the first socket that asks;
+// all sockets are assumed to belong to the same (Microsoft) provider.
+struct SocketExtensions {
+	LPFN_ACCEPTEX AcceptEx;
+	LPFN_GETACCEPTEXSOCKADDRS GetAcceptExSockaddrs;
+	LPFN_CONNECTEX ConnectEx;
+	LPFN_TRANSMITFILE TransmitFile;
+	static const SocketExtensions& Get(SOCKET sock) {
+		static const SocketExtensions instance = Load(sock);
+		return instance;
+	}
+private:
+	template <typename F>
+	static F Lookup(SOCKET sock, GUID guid) {
+		F result = nullptr;
+		DWORD bytes;
+		winapi_call(
+			::WSAIoctl(sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &result, sizeof(result), &bytes, nullptr, nullptr),
+			socket_error_check
+		);
+		return result;
+	}
+	static SocketExtensions Load(SOCKET sock) {
+		return {
+			Lookup<LPFN_ACCEPTEX>(sock, WSAID_ACCEPTEX),
+			Lookup<LPFN_GETACCEPTEXSOCKADDRS>(sock, WSAID_GETACCEPTEXSOCKADDRS),
+			Lookup<LPFN_CONNECTEX>(sock, WSAID_CONNECTEX),
+			Lookup<LPFN_TRANSMITFILE>(sock, WSAID_TRANSMITFILE)
+		};
+	}
+};
+
+// Overlapped socket operations return the byte count when they completed
+// inline and std::nullopt when a completion is pending. Unless
+// SkipCompletionPortOnSuccess is in effect an inline completion is still
+// queued to the port as well.
+class Socket {
+public:
+	// Size of each address slot AcceptEx needs in its output buffer
+	static constexpr DWORD AcceptAddressSize = sizeof(sockaddr_storage) + 16;
+	Socket() noexcept : sock(INVALID_SOCKET) {}
+	explicit Socket(SOCKET sock) noexcept : sock(sock) {}
+	Socket(int af, int type, int protocol) :
+		sock(winapi_call(::WSASocket(af, type, protocol, nullptr, 0, WSA_FLAG_OVERLAPPED), socket_create_error_check)) {}
+	~Socket() {
+		if (sock != INVALID_SOCKET) {
+			::closesocket(sock);
+		}
+	}
+	Socket(Socket&& other) noexcept : sock(std::exchange(other.sock, INVALID_SOCKET)) {}
+	Socket& operator=(Socket&& other) noexcept {
+		std::swap(sock, other.sock);
+		return *this;
+	}
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+	operator SOCKET() const { return sock; }
+	SOCKET get() const { return sock; }
+	// For IOCompletionPortHandle::AssocFile and other handle-based APIs
+	HANDLE AsHandle() const { return reinterpret_cast<HANDLE>(sock); }
+	void Bind(const sockaddr* addr, int len) const {
+		winapi_call(::bind(sock, addr, len), socket_error_check);
+	}
+	// Binds to the wildcard address and an ephemeral port, as ConnectEx requires
+	void BindAny(int af) const {
+		sockaddr_storage addr = {};
+		addr.ss_family = ADDRESS_FAMILY(af);
+		Bind(reinterpret_cast<const sockaddr*>(&addr), af == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in));
+	}
+	void Listen(int backlog = SOMAXCONN) const {
+		winapi_call(::listen(sock, backlog), socket_error_check);
+	}
+	void Shutdown(int how = SD_BOTH) const {
+		winapi_call(::shutdown(sock, how), socket_error_check);
+	}
+	template <typename T>
+	void SetOption(int level, int name, const T& value) const {
+		winapi_call(::setsockopt(sock, level, name, reinterpret_cast<const char*>(&value), sizeof(T)), socket_error_check);
+	}
+	template <typename T>
+	T GetOption(int level, int name) const {
+		T value;
+		int len = sizeof(T);
+		winapi_call(::getsockopt(sock, level, name, reinterpret_cast<char*>(&value), &len), socket_error_check);
+		return value;
+	}
+	WSAPROTOCOL_INFO ProtocolInfo() const {
+		return GetOption<WSAPROTOCOL_INFO>(SOL_SOCKET, SO_PROTOCOL_INFO);
+	}
+#if _WIN32_WINNT >= 0x0600
+	// Stops inline completions from being queued to the port (and from
+	// setting the socket handle). Only done for IFS providers, where it is
+	// reliable; returns whether it is in effect.
+	bool SkipCompletionPortOnSuccess() const {
+		if (!(ProtocolInfo().dwServiceFlags1 & XP1_IFS_HANDLES)) {
+			return false;
+		}
+		winapi_call(::SetFileCompletionNotificationModes(AsHandle(), FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE));
+		return true;
+	}
+#endif
+	std::optional<DWORD> Recv(std::span<WSABUF> buffers, OVERLAPPED& ovl, DWORD flags = 0) const {
+		DWORD bytes = 0;
+		bool done = ::WSARecv(sock, buffers.data(), DWORD(buffers.size()), &bytes, &flags, &ovl, nullptr) == 0;
+		return Inline(done, bytes);
+	}
+	std::optional<DWORD> Recv(std::span<std::byte> buffer, OVERLAPPED& ovl, DWORD flags = 0) const {
+		WSABUF buf = { ULONG(buffer.size()), reinterpret_cast<CHAR*>(buffer.data()) };
+		return Recv(std::span(&buf, 1), ovl, flags);
+	}
+	std::optional<DWORD> Send(std::span<WSABUF> buffers, OVERLAPPED& ovl, DWORD flags = 0) const {
+		DWORD bytes = 0;
+		bool done = ::WSASend(sock, buffers.data(), DWORD(buffers.size()), &bytes, flags, &ovl, nullptr) == 0;
+		return Inline(done, bytes);
+	}
+	std::optional<DWORD> Send(std::span<const std::byte> buffer, OVERLAPPED& ovl, DWORD flags = 0) const {
+		WSABUF buf = { ULONG(buffer.size()), reinterpret_cast<CHAR*>(const_cast<std::byte*>(buffer.data())) };
+		return Send(std::span(&buf, 1), ovl, flags);
+	}
+	// Accepts into an unbound socket of the same protocol; buffer receives
+	// the first receiveSize bytes followed by the two addresses. Call
+	// FinishAccept once it has completed.
+	std::optional<DWORD> Accept(const Socket& accepted, std::span<std::byte> buffer, DWORD receiveSize, OVERLAPPED& ovl) const {
+		DWORD bytes = 0;
+		bool done = SocketExtensions::Get(sock).AcceptEx(sock, accepted, buffer.data(), receiveSize,
+			AcceptAddressSize, AcceptAddressSize, &bytes, &ovl);
+		return Inline(done, bytes);
+	}
+	// Inherits the listener's properties so that the accepted socket works
+	// with getpeername, shutdown and the like
+	void FinishAccept(const Socket& listener) const {
+		SOCKET handle = listener;
+		SetOption(SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, handle);
+	}
+	// Requires a bound socket, see BindAny. Call FinishConnect once it has
+	// completed.
+	std::optional<DWORD> Connect(const sockaddr* addr, int len, OVERLAPPED& ovl, std::span<const std::byte> data = {}) const {
+		DWORD bytes = 0;
+		bool done = SocketExtensions::Get(sock).ConnectEx(sock, addr, len,
+			const_cast<std::byte*>(data.data()), DWORD(data.size()), &bytes, &ovl);
+		return Inline(done, bytes);
+	}
+	void FinishConnect() const {
+		winapi_call(::setsockopt(sock, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0), socket_error_check);
+	}
+	// Sends head, length bytes of file from offset, and tail without copying
+	// them through user mode. A zero length sends the rest of the file, and
+	// a NULL file only the buffers.
+	std::optional<DWORD> TransmitFile(HANDLE file, ULONGLONG offset, DWORD length, OVERLAPPED& ovl,
+		std::span<const std::byte> head = {}, std::span<const std::byte> tail = {}, DWORD flags = 0) const
+	{
+		ovl.Offset = DWORD(offset);
+		ovl.OffsetHigh = DWORD(offset >> 32);
+		TRANSMIT_FILE_BUFFERS buffers = {
+			const_cast<std::byte*>(head.data()), DWORD(head.size()),
+			const_cast<std::byte*>(tail.data()), DWORD(tail.size())
+		};
+		bool done = SocketExtensions::Get(sock).TransmitFile(sock, file, length, 0, &ovl,
+			(head.empty() && tail.empty()) ? nullptr : &buffers, flags);
+		if (!done) {
+			return Inline(false, 0);
+		}
+		// TransmitFile does not report a count, which a zero length leaves open
+		DWORD bytes = 0;
+		DWORD resultFlags = 0;
+		if (!::WSAGetOverlappedResult(sock, &ovl, &bytes, FALSE, &resultFlags)) {
+			throw std::system_error(win32_errc(::WSAGetLastError()));
+		}
+		return bytes;
+	}
+private:
+	static std::optional<DWORD> Inline(bool done, DWORD bytes) {
+		if (done) {
+			return bytes;
+		}
+		auto err = ::WSAGetLastError();
+		if (err != WSA_IO_PENDING) {
+			throw std::system_error(win32_errc(err));
+		}
+		return std::nullopt;
+	}
+	SOCKET sock;
+};
+
+#if _WIN32_WINNT >= 0x0600
+
+// Sends head, a range of a file and tail to a socket as one asynchronous
+// operation. The range goes through TransmitFile in chunks below its 2 GiB
+// limit; if the file handle does not support that, the transfer falls back
+// to reading chunks into a buffer and sending them. Fallback reads complete
+// on a thread pool wait that posts a packet for key to port, so no
+// dispatching thread blocks on the file. Completions for key are passed to
+// HandleCompletion; the callback runs once with the final error and the
+// number of bytes sent. The socket, file, buffers and the transfer itself
+// must stay alive until then. Pass skipOnSuccess if
+// SkipCompletionPortOnSuccess is in effect for the socket.
+class FileTransfer {
+public:
+	using Callback = std::function<void(DWORD error, ULONGLONG sent)>;
+	template <typename T>
+	FileTransfer(const IOCompletionPortHandle<T>& port, ULONG_PTR key, const Socket& socket, HANDLE file,
+		ULONGLONG offset, ULONGLONG length, Callback callback,
+		std::span<const std::byte> head = {}, std::span<const std::byte> tail = {},
+		bool skipOnSuccess = false, std::size_t bufferSize = 65536) :
+		port(static_cast<const T&>(port)),
+		key(key),
+		socket(socket),
+		file(file),
+		offset(offset),
+		remaining(length),
+		callback(std::move(callback)),
+		head(head),
+		tail(tail),
+		headDone(head.empty()),
+		tailDone(tail.empty()),
+		skipOnSuccess(skipOnSuccess),
+		bufferSize(bufferSize)
+	{}
+	~FileTransfer() {
+		if (wait) {
+			SetThreadpoolWait(wait, nullptr, nullptr);
+			WaitForThreadpoolWaitCallbacks(wait, TRUE);
+			CloseThreadpoolWait(wait);
+		}
+	}
+	FileTransfer(const FileTransfer&) = delete;
+	FileTransfer& operator=(const FileTransfer&) = delete;
+	void Start() {
+		Drive(std::nullopt);
+	}
+	// Returns false if the packet belongs to another operation
+	bool HandleCompletion(const CompletionStatusResult& status) {
+		if (status.key != key || (status.ovl != &ovl && status.ovl != &readOvl)) {
+			return false;
+		}
+		if (status.ovl == &readOvl) {
+			Drive(std::nullopt, true);
+		} else if (status.error != ERROR_SUCCESS) {
+			callback(status.error, sent);
+		} else {
+			Drive(status.bytesTransfered);
+		}
+		return true;
+	}
+	bool UsesFallback() const { return fallback; }
+private:
+	static constexpr ULONGLONG MaxChunk = ULONGLONG(1) << 30;
+	enum class Step {
+		Done,
+		Ready,
+		Reading
+	};
+	void Drive(std::optional<DWORD> completed, bool readDone = false) {
+		try {
+			if (readDone) {
+				FinishRead();
+			}
+			for (;;) {
+				if (completed) {
+					Account(*completed);
+				}
+				auto step = Next();
+				if (step == Step::Done) {
+					callback(ERROR_SUCCESS, sent);
+					return;
+				}
+				if (step == Step::Reading) {
+					return;
+				}
+				ovl = {};
+				if (fallback) {
+					completed = socket.Send(current, ovl);
+				} else if (!Transmit(completed)) {
+					StartFallback();
+					completed = 0;
+					continue;
+				}
+				if (!completed || !skipOnSuccess) {
+					return;
+				}
+			}
+		} catch (const std::system_error& e) {
+			callback(DWORD(e.code().value()), sent);
+		}
+	}
+	void Account(DWORD bytes) {
+		sent += bytes;
+		if (fallback) {
+			current = current.subspan(bytes);
+			return;
+		}
+		offset += chunk;
+		remaining -= chunk;
+		headDone = true;
+		tailDone = tailDone || remaining == 0;
+	}
+	Step Next() {
+		if (!fallback) {
+			return (remaining != 0 || !headDone || !tailDone) ? Step::Ready : Step::Done;
+		}
+		while (current.empty()) {
+			if (!headDone) {
+				current = head;
+				headDone = true;
+			} else if (remaining != 0) {
+				if (!StartRead()) {
+					return Step::Reading;
+				}
+			} else if (!tailDone) {
+				current = tail;
+				tailDone = true;
+			} else {
+				return Step::Done;
+			}
+		}
+		return Step::Ready;
+	}
+	// Returns false if the handle does not support TransmitFile
+	bool Transmit(std::optional<DWORD>& completed) {
+		chunk = std::min(remaining, MaxChunk);
+		try {
+			completed = socket.TransmitFile(chunk != 0 ? file : NULL, offset, DWORD(chunk), ovl,
+				headDone ? std::span<const std::byte>() : head,
+				chunk == remaining && !tailDone ? tail : std::span<const std::byte>());
+			return true;
+		} catch (const std::system_error& e) {
+			auto err = DWORD(e.code().value());
+			if (err != WSAEOPNOTSUPP && err != ERROR_NOT_SUPPORTED && err != ERROR_INVALID_FUNCTION && err != ERROR_INVALID_HANDLE) {
+				throw;
+			}
+		}
+		return false;
+	}
+	void StartFallback() {
+		buffer.resize(bufferSize);
+		event = Event(true, false);
+		wait = winapi_call(CreateThreadpoolWait(OnReadSignaled, this, nullptr));
+		fallback = true;
+	}
+	// Returns true if the chunk was read inline, false while it is pending
+	bool StartRead() {
+		readOvl = {};
+		readOvl.Offset = DWORD(offset);
+		readOvl.OffsetHigh = DWORD(offset >> 32);
+		// the low bit keeps the read off the file's completion port
+		readOvl.hEvent = HANDLE(ULONG_PTR(event.get()) | 1);
+		DWORD size = DWORD(std::min<ULONGLONG>(remaining, buffer.size()));
+		if (::ReadFile(file, buffer.data(), size, nullptr, &readOvl)) {
+			FinishRead();
+			return true;
+		}
+		auto err = GetLastError();
+		if (err != ERROR_IO_PENDING) {
+			throw std::system_error(win32_errc(err));
+		}
+		SetThreadpoolWait(wait, event.get(), nullptr);
+		return false;
+	}
+	void FinishRead() {
+		DWORD done = 0;
+		winapi_call(::GetOverlappedResult(file, &readOvl, &done, FALSE));
+		if (done == 0) {
+			throw std::system_error(win32_errc(ERROR_HANDLE_EOF));
+		}
+		offset += done;
+		remaining -= done;
+		current = { buffer.data(), done };
+	}
+	static void CALLBACK OnReadSignaled(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WAIT, TP_WAIT_RESULT) {
+		auto& self = *static_cast<FileTransfer*>(context);
+		if (!::PostQueuedCompletionStatus(self.port, 0, self.key, &self.readOvl)) {
+			self.callback(GetLastError(), self.sent);
+		}
+	}
+	HANDLE port;
+	ULONG_PTR key;
+	const Socket& socket;
+	HANDLE file;
+	ULONGLONG offset;
+	ULONGLONG remaining;
+	Callback callback;
+	std::span<const std::byte> head;
+	std::span<const std::byte> tail;
+	bool headDone;
+	bool tailDone;
+	bool skipOnSuccess;
+	bool fallback = false;
+	std::size_t bufferSize;
+	ULONGLONG chunk = 0;
+	ULONGLONG sent = 0;
+	OVERLAPPED ovl = {};
+	OVERLAPPED readOvl = {};
+	std::vector<std::byte> buffer;
+	std::span<const std::byte> current;
+	Event event;
+	PTP_WAIT wait = nullptr;
+};
+
+#endif
+
+// Keeps a number of AcceptEx calls pending on a listening socket, which it
+// owns and associates with the port under key. Completions are dispatched by
+// the caller's threads through HandleCompletion; each accepted socket is
+// passed to the callback on that thread, after the slot has been reposted.
+// The destructor cancels the pending accepts and waits until they have been
+// dispatched, so other threads must keep dispatching until it returns.
+class AcceptPool {
+public:
+	using Callback = std::function<void(Socket socket, const sockaddr* local, const sockaddr* remote)>;
+	template <typename T>
+	AcceptPool(const IOCompletionPortHandle<T>& port, ULONG_PTR key, Socket listener, std::size_t depth, Callback callback) :
+		dispatcher(port, key),
+		listener(std::move(listener)),
+		info(this->listener.ProtocolInfo()),
+		callback(std::move(callback)),
+		slots(std::make_unique<Slot[]>(depth)),
+		active(depth)
+	{
+		dispatcher.Associate(this->listener.AsHandle());
+#if _WIN32_WINNT >= 0x0600
+		skipOnSuccess = this->listener.SkipCompletionPortOnSuccess();
+#endif
+		for (std::size_t i = 0; i < depth; ++i) {
+			slots[i].pool = this;
+		}
+		for (std::size_t i = 0; i < depth; ++i) {
+			if (Post(slots[i]) == Posted::Inline) {
+				Finish(slots[i], ERROR_SUCCESS);
+			}
+		}
+	}
+	~AcceptPool() {
+		Stop();
+		std::unique_lock lock(mutex);
+		drained.wait(lock, [this]{ return active.load() == 0; });
+	}
+	AcceptPool(const AcceptPool&) = delete;
+	AcceptPool& operator=(const AcceptPool&) = delete;
+	// Returns false if the packet does not belong to this pool
+	bool HandleCompletion(const CompletionStatusResult& status) {
+		return dispatcher.HandleCompletion(status);
+	}
+	void Stop() {
+		stopping = true;
+		::CancelIoEx(listener.AsHandle(), nullptr);
+	}
+	const Socket& Listener() const { return listener; }
+	std::size_t Active() const { return active.load(); }
+private:
+	struct Slot : IoOperation {
+		Slot() noexcept : IoOperation(Accepted) {}
+		AcceptPool* pool;
+		Socket socket;
+		std::byte buffer[2 * Socket::AcceptAddressSize];
+	};
+	enum class Posted {
+		Pending,
+		Inline,
+		Retired
+	};
+	static void Accepted(IoOperation& op, DWORD error, DWORD) {
+		auto& slot = static_cast<Slot&>(op);
+		slot.pool->Finish(slot, error);
+	}
+	Posted Post(Slot& slot) {
+		for (;;) {
+			if (stopping) {
+				Retire();
+				return Posted::Retired;
+			}
+			try {
+				slot.socket = Socket(info.iAddressFamily, info.iSocketType, info.iProtocol);
+				static_cast<OVERLAPPED&>(slot) = {};
+				auto done = listener.Accept(slot.socket, slot.buffer, 0, slot);
+				// Stop may have cancelled before the accept was issued
+				if (stopping) {
+					::CancelIoEx(listener.AsHandle(), &slot);
+				}
+				return (done && skipOnSuccess) ? Posted::Inline : Posted::Pending;
+			} catch (const std::system_error& e) {
+				// a client that reset before being accepted is not an error
+				if (e.code() != std::error_code(win32_errc(WSAECONNRESET))) {
+					Retire();
+					return Posted::Retired;
+				}
+			}
+		}
+	}
+	void Finish(Slot& slot, DWORD error) {
+		for (;;) {
+			std::optional<Socket> accepted;
+			sockaddr_storage local = {}, remote = {};
+			if (error == ERROR_SUCCESS) {
+				try {
+					slot.socket.FinishAccept(listener);
+					sockaddr* localPtr;
+					sockaddr* remotePtr;
+					int localLen, remoteLen;
+					SocketExtensions::Get(listener).GetAcceptExSockaddrs(slot.buffer, 0,
+						Socket::AcceptAddressSize, Socket::AcceptAddressSize, &localPtr, &localLen, &remotePtr, &remoteLen);
+					std::memcpy(&local, localPtr, std::min<std::size_t>(localLen, sizeof(local)));
+					std::memcpy(&remote, remotePtr, std::min<std::size_t>(remoteLen, sizeof(remote)));
+					accepted.emplace(std::move(slot.socket));
+				} catch (const std::system_error&) {
+				}
+			}
+			auto posted = Post(slot);
+			if (accepted) {
+				callback(std::move(*accepted), reinterpret_cast<const sockaddr*>(&local), reinterpret_cast<const sockaddr*>(&remote));
+			}
+			if (posted != Posted::Inline) {
+				return;
+			}
+			error = ERROR_SUCCESS;
+		}
+	}
+	void Retire() {
+		if (active.fetch_sub(1) == 1) {
+			std::lock_guard lock(mutex);
+			drained.notify_all();
+		}
+	}
+	IoDispatcher dispatcher;
+	Socket listener;
+	WSAPROTOCOL_INFO info;
+	Callback callback;
+	std::unique_ptr<Slot[]> slots;
+	std::atomic<std::size_t> active;
+	std::atomic<bool> stopping = false;
+	bool skipOnSuccess = false;
+	std::mutex mutex;
+	std::condition_variable drained;
+};
+
+}
+
+#endif // SWAL_SOCKET_H
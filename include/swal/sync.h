@@ -0,0 +1,209 @@
+#ifndef SWAL_SYNC_H
+#define SWAL_SYNC_H
+
+#include "win_headers.h"
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <system_error>
+#include <type_traits>
+#include "enum_bitwise.h"
+#include "error.h"
+
+namespace swal {
+
+#if _WIN32_WINNT >= 0x0600
+
+// Counts acquisitions that found the lock already held; always 0 with NDEBUG
+class ContentionCounter {
+public:
+#ifndef NDEBUG
+	void Add() noexcept { count.fetch_add(1, std::memory_order_relaxed); }
+	std::size_t Get() const noexcept { return count.load(std::memory_order_relaxed); }
+	void Reset() noexcept { count.store(0, std::memory_order_relaxed); }
+private:
+	std::atomic<std::size_t> count = 0;
+#else
+	void Add() noexcept {}
+	std::size_t Get() const noexcept { return 0; }
+	void Reset() noexcept {}
+#endif
+};
+
+class SRWLock {
+public:
+	SRWLock() noexcept = default;
+	SRWLock(const SRWLock&) = delete;
+	SRWLock& operator=(const SRWLock&) = delete;
+	void lock() noexcept {
+#ifndef NDEBUG
+		if (TryAcquireSRWLockExclusive(&srw)) {
+			return;
+		}
+		contentions.Add();
+#endif
+		AcquireSRWLockExclusive(&srw);
+	}
+	bool try_lock() noexcept { return TryAcquireSRWLockExclusive(&srw); }
+	void unlock() noexcept { ReleaseSRWLockExclusive(&srw); }
+	void lock_shared() noexcept {
+#ifndef NDEBUG
+		if (TryAcquireSRWLockShared(&srw)) {
+			return;
+		}
+		contentions.Add();
+#endif
+		AcquireSRWLockShared(&srw);
+	}
+	bool try_lock_shared() noexcept { return TryAcquireSRWLockShared(&srw); }
+	void unlock_shared() noexcept { ReleaseSRWLockShared(&srw); }
+	SRWLOCK* native_handle() noexcept { return &srw; }
+	const ContentionCounter& Contentions() const noexcept { return contentions; }
+private:
+	SRWLOCK srw = SRWLOCK_INIT;
+	ContentionCounter contentions;
+};
+
+class CriticalSection {
+public:
+	explicit CriticalSection(DWORD spinCount = 0) {
+		winapi_call(InitializeCriticalSectionEx(&cs, spinCount, 0));
+	}
+	~CriticalSection() { DeleteCriticalSection(&cs); }
+	CriticalSection(const CriticalSection&) = delete;
+	CriticalSection& operator=(const CriticalSection&) = delete;
+	void lock() noexcept {
+#ifndef NDEBUG
+		if (TryEnterCriticalSection(&cs)) {
+			return;
+		}
+		contentions.Add();
+#endif
+		EnterCriticalSection(&cs);
+	}
+	bool try_lock() noexcept { return TryEnterCriticalSection(&cs); }
+	void unlock() noexcept { LeaveCriticalSection(&cs); }
+	DWORD SetSpinCount(DWORD spinCount) noexcept { return SetCriticalSectionSpinCount(&cs, spinCount); }
+	CRITICAL_SECTION* native_handle() noexcept { return &cs; }
+	const ContentionCounter& Contentions() const noexcept { return contentions; }
+private:
+	CRITICAL_SECTION cs;
+	ContentionCounter contentions;
+};
+
+inline DWORD SleepConditionVariable_error_check(BOOL result) {
+	if (!result) {
+		auto err = GetLastError();
+		if (err != ERROR_TIMEOUT) {
+			return err;
+		}
+	}
+	return ERROR_SUCCESS;
+}
+
+class ConditionVariable {
+public:
+	ConditionVariable() noexcept = default;
+	ConditionVariable(const ConditionVariable&) = delete;
+	ConditionVariable& operator=(const ConditionVariable&) = delete;
+	void NotifyOne() noexcept { WakeConditionVariable(&cv); }
+	void NotifyAll() noexcept { WakeAllConditionVariable(&cv); }
+	bool Wait(SRWLock& lock, DWORD milliseconds = INFINITE) {
+		return winapi_call(SleepConditionVariableSRW(&cv, lock.native_handle(), milliseconds, 0), SleepConditionVariable_error_check);
+	}
+	bool WaitShared(SRWLock& lock, DWORD milliseconds = INFINITE) {
+		return winapi_call(SleepConditionVariableSRW(&cv, lock.native_handle(), milliseconds, CONDITION_VARIABLE_LOCKMODE_SHARED), SleepConditionVariable_error_check);
+	}
+	bool Wait(CriticalSection& lock, DWORD milliseconds = INFINITE) {
+		return winapi_call(SleepConditionVariableCS(&cv, lock.native_handle(), milliseconds), SleepConditionVariable_error_check);
+	}
+	template <typename Lock>
+	bool Wait(std::unique_lock<Lock>& lock, DWORD milliseconds = INFINITE) {
+		return Wait(*lock.mutex(), milliseconds);
+	}
+	template <typename Lock>
+	bool Wait(std::shared_lock<Lock>& lock, DWORD milliseconds = INFINITE) {
+		return WaitShared(*lock.mutex(), milliseconds);
+	}
+	template <typename Lock, std::predicate Pred>
+	void Wait(Lock& lock, Pred pred) {
+		while (!pred()) {
+			Wait(lock);
+		}
+	}
+	CONDITION_VARIABLE* native_handle() noexcept { return &cv; }
+private:
+	CONDITION_VARIABLE cv = CONDITION_VARIABLE_INIT;
+};
+
+#endif
+
+#if _WIN32_WINNT >= 0x0602
+
+template <typename T>
+concept AddressWaitable = std::is_trivially_copyable_v<T> &&
+	(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+// Returns false on timeout. Like any futex, it can wake spuriously, so the
+// caller re-checks the value.
+template <AddressWaitable T>
+bool WaitOnAddress(const volatile T& address, std::type_identity_t<T> compare, DWORD milliseconds = INFINITE) {
+	if (::WaitOnAddress(const_cast<volatile T*>(&address), &compare, sizeof(T), milliseconds)) {
+		return true;
+	}
+	auto err = GetLastError();
+	if (err == ERROR_TIMEOUT) {
+		return false;
+	}
+	throw std::system_error(win32_errc(err));
+}
+
+template <AddressWaitable T>
+bool WaitOnAddress(const std::atomic<T>& address, std::type_identity_t<T> compare, DWORD milliseconds = INFINITE) {
+	static_assert(sizeof(std::atomic<T>) == sizeof(T));
+	return WaitOnAddress(reinterpret_cast<const volatile T&>(address), compare, milliseconds);
+}
+
+template <typename T>
+void WakeByAddressSingle(const T& address) noexcept {
+	::WakeByAddressSingle(const_cast<T*>(&address));
+}
+
+template <typename T>
+void WakeByAddressAll(const T& address) noexcept {
+	::WakeByAddressAll(const_cast<T*>(&address));
+}
+
+enum class BarrierFlags : DWORD {
+	None = 0,
+	SpinOnly = SYNCHRONIZATION_BARRIER_FLAGS_SPIN_ONLY,
+	BlockOnly = SYNCHRONIZATION_BARRIER_FLAGS_BLOCK_ONLY,
+	NoDelete = SYNCHRONIZATION_BARRIER_FLAGS_NO_DELETE
+};
+
+template <> struct enable_enum_bitwise<enum BarrierFlags> : std::true_type {};
+
+class SynchronizationBarrier {
+public:
+	explicit SynchronizationBarrier(LONG threads, LONG spinCount = -1) {
+		winapi_call(InitializeSynchronizationBarrier(&barrier, threads, spinCount));
+	}
+	~SynchronizationBarrier() { DeleteSynchronizationBarrier(&barrier); }
+	SynchronizationBarrier(const SynchronizationBarrier&) = delete;
+	SynchronizationBarrier& operator=(const SynchronizationBarrier&) = delete;
+	// true for exactly one of the threads released by each phase
+	bool Enter(BarrierFlags flags = BarrierFlags::None) noexcept {
+		return EnterSynchronizationBarrier(&barrier, static_cast<DWORD>(flags));
+	}
+	void arrive_and_wait() noexcept { Enter(); }
+private:
+	SYNCHRONIZATION_BARRIER barrier;
+};
+
+#endif
+
+}
+
+#endif // SWAL_SYNC_H
@@ -0,0 +1,348 @@
+#ifndef SWAL_TIMER_WHEEL_H
+#define SWAL_TIMER_WHEEL_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "handle.h"
+
+namespace swal {
+
+#if _WIN32_WINNT >= 0x0600
+
+class TimerWheel;
+
+// Intrusive timer entry owned by the caller, so scheduling never allocates.
+// Once Cancel returns false the callback is pending or running, and the node
+// must not be rescheduled or destroyed until it has been called.
+class TimerNode {
+public:
+	using Callback = void(*)(TimerNode&) noexcept;
+	explicit TimerNode(Callback callback) noexcept : callback(callback) {}
+	TimerNode(const TimerNode&) = delete;
+	TimerNode& operator=(const TimerNode&) = delete;
+private:
+	friend class TimerWheel;
+	TimerNode* next = nullptr;
+	TimerNode** pprev = nullptr;
+	std::uint64_t deadline = 0;
+	Callback callback;
+};
+
+// Posts (0, key, ovl) to a completion port on expiry.
+class IocpTimer : public TimerNode {
+public:
+	IocpTimer(HANDLE port, ULONG_PTR key, OVERLAPPED* ovl = nullptr) noexcept :
+		TimerNode(Fire), port(port), key(key), ovl(ovl) {}
+private:
+	static void Fire(TimerNode& node) noexcept {
+		auto& self = static_cast<IocpTimer&>(node);
+		::PostQueuedCompletionStatus(self.port, 0, self.key, self.ovl);
+	}
+	HANDLE port;
+	ULONG_PTR key;
+	OVERLAPPED* ovl;
+};
+
+// Hierarchical timing wheel (5 levels of 64 slots) multiplexing any number of
+// deadlines onto one WaitableTimer. Wait on Timer() from any thread or wait
+// API and call Advance when it is signalled; Advance runs the expired
+// callbacks on the calling thread and re-arms the kernel timer for the
+// earliest deadline. A bitmap of occupied slots per level lets both skip
+// empty stretches of the wheel instead of stepping through every tick.
+class TimerWheel {
+public:
+	using clock = std::chrono::steady_clock;
+	class SleepAwaiter : public TimerNode {
+	public:
+		SleepAwaiter(TimerWheel& wheel, clock::time_point deadline) noexcept :
+			TimerNode(Fire), wheel(wheel), deadline(deadline) {}
+		bool await_ready() const noexcept { return deadline <= clock::now(); }
+		void await_suspend(std::coroutine_handle<> handle) {
+			this->handle = handle;
+			wheel.Schedule(*this, deadline);
+		}
+		void await_resume() const noexcept {}
+	private:
+		static void Fire(TimerNode& node) noexcept {
+			static_cast<SleepAwaiter&>(node).handle.resume();
+		}
+		TimerWheel& wheel;
+		clock::time_point deadline;
+		std::coroutine_handle<> handle;
+	};
+	explicit TimerWheel(clock::duration resolution = std::chrono::milliseconds(1)) :
+		timer(WaitableTimer::PreferHighResolution(false)),
+		resolution(resolution),
+		start(clock::now())
+	{}
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+	const WaitableTimer& Timer() const { return timer; }
+	void Schedule(TimerNode& node, clock::time_point deadline) {
+		std::lock_guard lock(mutex);
+		if (node.pprev) {
+			Unlink(node);
+		}
+		node.deadline = ToTick(deadline);
+		Insert(node);
+		++count;
+		auto tick = std::max(node.deadline, current);
+		if (tick < armed) {
+			Arm(tick);
+		}
+	}
+	void Schedule(TimerNode& node, clock::duration timeout) {
+		Schedule(node, clock::now() + timeout);
+	}
+	bool Cancel(TimerNode& node) {
+		std::lock_guard lock(mutex);
+		if (!node.pprev) {
+			return false;
+		}
+		Unlink(node);
+		return true;
+	}
+	SleepAwaiter SleepUntil(clock::time_point deadline) { return { *this, deadline }; }
+	SleepAwaiter SleepFor(clock::duration timeout) { return { *this, clock::now() + timeout }; }
+	std::size_t Advance() {
+		TimerNode* expired = nullptr;
+		{
+			std::lock_guard lock(mutex);
+			auto target = ToTickFloor(clock::now());
+			while (count != 0) {
+				// the ticks in between have nothing to expire or cascade
+				auto next = NextEvent();
+				if (next > target) {
+					break;
+				}
+				current = next;
+				if ((current & Mask) == 0) {
+					for (unsigned level = 1; level < Levels; ++level) {
+						auto idx = (current >> (LevelBits * level)) & Mask;
+						Cascade(level, idx);
+						if (idx != 0) {
+							break;
+						}
+					}
+				}
+				auto& slot = wheel[0][current & Mask];
+				while (slot) {
+					auto& node = *slot;
+					Unlink(node);
+					node.next = expired;
+					expired = &node;
+				}
+				++current;
+			}
+			if (current <= target) {
+				current = target + 1;
+			}
+			// the kernel timer has been consumed, so always set it again
+			armed = NoTick;
+			Rearm();
+		}
+		std::size_t fired = 0;
+		while (expired) {
+			auto& node = *expired;
+			expired = node.next;
+			node.next = nullptr;
+			node.callback(node);
+			++fired;
+		}
+		return fired;
+	}
+	std::size_t Size() const {
+		std::lock_guard lock(mutex);
+		return count;
+	}
+private:
+	static constexpr unsigned LevelBits = 6;
+	static constexpr unsigned Levels = 5;
+	static constexpr std::uint64_t Slots = std::uint64_t(1) << LevelBits;
+	static constexpr std::uint64_t Mask = Slots - 1;
+	static constexpr std::uint64_t MaxDelta = (std::uint64_t(1) << (LevelBits * Levels)) - 1;
+	static constexpr std::uint64_t NoTick = std::numeric_limits<std::uint64_t>::max();
+	// rounds up so that a timer never fires early
+	std::uint64_t ToTick(clock::time_point t) const {
+		if (t <= start) {
+			return 0;
+		}
+		return std::uint64_t((t - start + resolution - clock::duration(1)) / resolution);
+	}
+	std::uint64_t ToTickFloor(clock::time_point t) const {
+		if (t <= start) {
+			return 0;
+		}
+		return std::uint64_t((t - start) / resolution);
+	}
+	clock::time_point FromTick(std::uint64_t tick) const {
+		return start + resolution * tick;
+	}
+	void Insert(TimerNode& node) {
+		auto tick = std::max(node.deadline, current);
+		auto delta = std::min(tick - current, MaxDelta);
+		tick = current + delta;
+		unsigned level = 0;
+		while (level + 1 < Levels && delta >= (std::uint64_t(1) << (LevelBits * (level + 1)))) {
+			++level;
+		}
+		auto slot = (tick >> (LevelBits * level)) & Mask;
+		auto& head = wheel[level][slot];
+		occupied[level] |= std::uint64_t(1) << slot;
+		node.next = head;
+		if (head) {
+			head->pprev = &node.next;
+		}
+		head = &node;
+		node.pprev = &head;
+	}
+	void Unlink(TimerNode& node) {
+		*node.pprev = node.next;
+		if (node.next) {
+			node.next->pprev = node.pprev;
+		} else if (IsSlot(node.pprev)) {
+			auto index = std::size_t(node.pprev - &wheel[0][0]);
+			occupied[index / Slots] &= ~(std::uint64_t(1) << (index % Slots));
+		}
+		node.next = nullptr;
+		node.pprev = nullptr;
+		--count;
+	}
+	bool IsSlot(TimerNode** p) const {
+		std::less_equal<TimerNode* const*> le;
+		return le(&wheel[0][0], p) && le(p, &wheel[Levels - 1][Slots - 1]);
+	}
+	void Cascade(unsigned level, std::uint64_t slot) {
+		occupied[level] &= ~(std::uint64_t(1) << slot);
+		auto node = std::exchange(wheel[level][slot], nullptr);
+		while (node) {
+			auto next = node->next;
+			Insert(*node);
+			node = next;
+		}
+	}
+	// First occupied slot of level in the order the wheel reaches them, and
+	// the tick at which that happens: the slot's own tick on level 0 and the
+	// tick at which it is cascaded on the levels above
+	bool FirstSlot(unsigned level, std::uint64_t& slot, std::uint64_t& tick) const {
+		if (!occupied[level]) {
+			return false;
+		}
+		auto shift = LevelBits * level;
+		auto base = current >> shift;
+		auto idx = base & Mask;
+		auto ahead = std::rotr(occupied[level], int(idx));
+		// an upper level's current slot has been cascaded already unless the
+		// wheel stands right at its boundary, so it comes round again last
+		if (level != 0 && (current & ((std::uint64_t(1) << shift) - 1)) != 0) {
+			ahead &= ~std::uint64_t(1);
+		}
+		std::uint64_t distance = ahead ? std::countr_zero(ahead) : Slots;
+		slot = (idx + distance) & Mask;
+		tick = (base + distance) << shift;
+		return true;
+	}
+	std::uint64_t NextEvent() const {
+		auto next = NoTick;
+		for (unsigned level = 0; level < Levels; ++level) {
+			std::uint64_t slot, tick;
+			if (FirstSlot(level, slot, tick)) {
+				next = std::min(next, tick);
+			}
+		}
+		return next;
+	}
+	// The earliest deadline of a level is in the first slot the wheel
+	// reaches, since each slot covers a later range of ticks than the last
+	std::uint64_t EarliestDeadline() const {
+		auto earliest = NoTick;
+		for (unsigned level = 0; level < Levels; ++level) {
+			std::uint64_t slot, tick;
+			if (!FirstSlot(level, slot, tick)) {
+				continue;
+			}
+			for (auto node = wheel[level][slot]; node; node = node->next) {
+				earliest = std::min(earliest, std::max(node->deadline, current));
+			}
+		}
+		return earliest;
+	}
+	void Arm(std::uint64_t tick) {
+		timer.SetRelative(FromTick(tick) - clock::now());
+		armed = tick;
+	}
+	void Rearm() {
+		if (count == 0) {
+			if (armed != NoTick) {
+				timer.Cancel();
+				armed = NoTick;
+			}
+			return;
+		}
+		auto next = EarliestDeadline();
+		if (next != armed) {
+			Arm(next);
+		}
+	}
+	WaitableTimer timer;
+	clock::duration resolution;
+	clock::time_point start;
+	mutable std::mutex mutex;
+	TimerNode* wheel[Levels][Slots] = {};
+	std::uint64_t occupied[Levels] = {};
+	std::uint64_t current = 0;
+	std::uint64_t armed = NoTick;
+	std::size_t count = 0;
+};
+
+// Cancels one pending overlapped operation with CancelIoEx if it is still
+// running at the deadline. Keep it alive until the operation has completed;
+// the destructor waits for an expiry that is already in flight, which is
+// only ever the length of the CancelIoEx call.
+class IoDeadline : private TimerNode {
+public:
+	IoDeadline(TimerWheel& wheel, HANDLE file, OVERLAPPED& ovl, TimerWheel::clock::time_point deadline) :
+		TimerNode(Fire), wheel(wheel), file(file), ovl(&ovl)
+	{
+		wheel.Schedule(*this, deadline);
+	}
+	IoDeadline(TimerWheel& wheel, HANDLE file, OVERLAPPED& ovl, TimerWheel::clock::duration timeout) :
+		IoDeadline(wheel, file, ovl, TimerWheel::clock::now() + timeout) {}
+	~IoDeadline() {
+		if (!wheel.Cancel(*this)) {
+			while (!fired.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+	IoDeadline(const IoDeadline&) = delete;
+	IoDeadline& operator=(const IoDeadline&) = delete;
+	bool Expired() const noexcept { return fired.load(); }
+private:
+	static void Fire(TimerNode& node) noexcept {
+		auto& self = static_cast<IoDeadline&>(node);
+		::CancelIoEx(self.file, self.ovl);
+		self.fired.store(true, std::memory_order_release);
+	}
+	TimerWheel& wheel;
+	HANDLE file;
+	OVERLAPPED* ovl;
+	std::atomic<bool> fired = false;
+};
+
+#endif
+
+}
+
+#endif // SWAL_TIMER_WHEEL_H
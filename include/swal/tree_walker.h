@@ -0,0 +1,226 @@
+#ifndef SWAL_TREE_WALKER_H
+#define SWAL_TREE_WALKER_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "error.h"
+#include "handle.h"
+
+namespace swal {
+
+#if _WIN32_WINNT >= 0x0600
+
+struct TreeEntry {
+	// full path of the containing directory
+	std::wstring_view directory;
+	std::wstring_view name;
+	LARGE_INTEGER fileId;
+	LARGE_INTEGER creationTime;
+	LARGE_INTEGER lastAccessTime;
+	LARGE_INTEGER lastWriteTime;
+	LARGE_INTEGER changeTime;
+	ULONGLONG size;
+	ULONGLONG allocationSize;
+	DWORD attributes;
+	bool IsDirectory() const { return attributes & FILE_ATTRIBUTE_DIRECTORY; }
+	bool IsReparsePoint() const { return attributes & FILE_ATTRIBUTE_REPARSE_POINT; }
+};
+
+// Walks a directory tree on a pool of threads. Each directory is opened as a
+// File and read in bulk with FileIdBothDirectoryInfo into a per-thread
+// buffer; subdirectories go onto the finding thread's queue, from which idle
+// threads steal. f(const TreeEntry&) runs concurrently on every thread and
+// returns whether to descend into a directory entry; reparse points are
+// never followed. Directories that cannot be opened are skipped and counted.
+class TreeWalker {
+public:
+	struct Stats {
+		std::size_t directories;
+		std::size_t entries;
+		std::size_t steals;
+		std::size_t errors;
+	};
+	explicit TreeWalker(unsigned threads = 0, DWORD bufferSize = 64 * 1024) :
+		threads(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+		bufferSize(bufferSize) {}
+	// Blocks until the whole tree has been walked; rethrows the first
+	// exception thrown by f after stopping the other threads
+	template <typename F>
+	Stats Walk(const std::wstring& root, F&& f) {
+		Run run(threads);
+		run.queues[0].items.push_back(root);
+		run.pending.store(1, std::memory_order_relaxed);
+		{
+			std::vector<std::jthread> workers;
+			workers.reserve(threads - 1);
+			for (unsigned i = 1; i < threads; ++i) {
+				workers.emplace_back([&, i]{ Work(run, i, f); });
+			}
+			Work(run, 0, f);
+		}
+		if (run.error) {
+			std::rethrow_exception(run.error);
+		}
+		return {
+			run.directories.load(), run.entries.load(), run.steals.load(), run.errors.load()
+		};
+	}
+private:
+	struct alignas(64) Queue {
+		std::mutex mutex;
+		std::deque<std::wstring> items;
+	};
+	struct Run {
+		explicit Run(unsigned threads) : queues(std::make_unique<Queue[]>(threads)), count(threads) {}
+		std::unique_ptr<Queue[]> queues;
+		unsigned count;
+		alignas(64) std::atomic<std::size_t> pending = 0;
+		alignas(64) std::atomic<std::uint32_t> signal = 0;
+		std::atomic<bool> failed = false;
+		std::atomic<std::size_t> directories = 0;
+		std::atomic<std::size_t> entries = 0;
+		std::atomic<std::size_t> steals = 0;
+		std::atomic<std::size_t> errors = 0;
+		std::mutex errorMutex;
+		std::exception_ptr error;
+	};
+	// newest first from the own queue, oldest first from the others
+	static std::optional<std::wstring> Take(Run& run, unsigned self) {
+		{
+			auto& own = run.queues[self];
+			std::lock_guard lock(own.mutex);
+			if (!own.items.empty()) {
+				auto item = std::move(own.items.back());
+				own.items.pop_back();
+				return item;
+			}
+		}
+		for (unsigned i = 1; i < run.count; ++i) {
+			auto& victim = run.queues[(self + i) % run.count];
+			std::lock_guard lock(victim.mutex);
+			if (!victim.items.empty()) {
+				auto item = std::move(victim.items.front());
+				victim.items.pop_front();
+				run.steals.fetch_add(1, std::memory_order_relaxed);
+				return item;
+			}
+		}
+		return std::nullopt;
+	}
+	template <typename F>
+	void Work(Run& run, unsigned self, F& f) {
+		std::vector<std::uint64_t> buffer(bufferSize / sizeof(std::uint64_t));
+		for (;;) {
+			auto seen = run.signal.load(std::memory_order_acquire);
+			auto item = Take(run, self);
+			if (!item) {
+				if (run.pending.load(std::memory_order_acquire) == 0) {
+					return;
+				}
+				run.signal.wait(seen, std::memory_order_acquire);
+				continue;
+			}
+			if (!run.failed.load(std::memory_order_relaxed)) {
+				try {
+					Process(run, self, *item, buffer, f);
+				} catch (...) {
+					std::lock_guard lock(run.errorMutex);
+					if (!run.error) {
+						run.error = std::current_exception();
+					}
+					run.failed.store(true, std::memory_order_relaxed);
+				}
+			}
+			if (run.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				run.signal.fetch_add(1, std::memory_order_release);
+				run.signal.notify_all();
+			}
+		}
+	}
+	template <typename F>
+	static void Process(Run& run, unsigned self, const std::wstring& path, std::vector<std::uint64_t>& buffer, F& f) {
+		HANDLE handle = ::CreateFileW(path.c_str(), FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		if (handle == INVALID_HANDLE_VALUE) {
+			run.errors.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		File dir(handle);
+		run.directories.fetch_add(1, std::memory_order_relaxed);
+		std::size_t found = 0;
+		auto size = DWORD(buffer.size() * sizeof(std::uint64_t));
+		for (bool restart = true; Query(run, dir, buffer.data(), size, restart); restart = false) {
+			auto pos = reinterpret_cast<const BYTE*>(buffer.data());
+			for (;;) {
+				auto& info = *reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(pos);
+				std::wstring_view name(info.FileName, info.FileNameLength / sizeof(WCHAR));
+				if (name != L"." && name != L"..") {
+					TreeEntry entry = {
+						path, name, info.FileId, info.CreationTime, info.LastAccessTime, info.LastWriteTime,
+						info.ChangeTime, ULONGLONG(info.EndOfFile.QuadPart), ULONGLONG(info.AllocationSize.QuadPart),
+						info.FileAttributes
+					};
+					++found;
+					if (f(static_cast<const TreeEntry&>(entry)) && entry.IsDirectory() && !entry.IsReparsePoint()) {
+						Push(run, self, path, name);
+					}
+				}
+				if (info.NextEntryOffset == 0) {
+					break;
+				}
+				pos += info.NextEntryOffset;
+			}
+			if (run.failed.load(std::memory_order_relaxed)) {
+				break;
+			}
+		}
+		run.entries.fetch_add(found, std::memory_order_relaxed);
+	}
+	static bool Query(Run& run, const File& dir, void* buffer, DWORD size, bool restart) {
+		try {
+			return dir.QueryDirectory(buffer, size, restart);
+		} catch (const std::system_error&) {
+			run.errors.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+	static void Push(Run& run, unsigned self, const std::wstring& parent, std::wstring_view name) {
+		std::wstring child;
+		child.reserve(parent.size() + 1 + name.size());
+		child.append(parent);
+		if (!child.empty() && child.back() != L'\\') {
+			child.push_back(L'\\');
+		}
+		child.append(name);
+		// counted before it is published, or a thief could finish the child
+		// and take the count to zero while the parent is still running
+		run.pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			auto& own = run.queues[self];
+			std::lock_guard lock(own.mutex);
+			own.items.push_back(std::move(child));
+		}
+		run.signal.fetch_add(1, std::memory_order_release);
+		run.signal.notify_one();
+	}
+	unsigned threads;
+	DWORD bufferSize;
+};
+
+#endif
+
+}
+
+#endif // SWAL_TREE_WALKER_H
@@ -0,0 +1,153 @@
+#ifndef SWAL_VIRTUAL_ARENA_H
+#define SWAL_VIRTUAL_ARENA_H
+
+#include "win_headers.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include "error.h"
+
+namespace swal {
+
+#if _WIN32_WINNT >= 0x0600
+
+// Enables SeLockMemoryPrivilege in the process token, which MEM_LARGE_PAGES
+// requires; returns false if the account has not been granted it
+inline bool EnableLockMemoryPrivilege() noexcept {
+	HANDLE token;
+	if (!::OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		return false;
+	}
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED when the
+	// privilege is missing
+	bool result = ::LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+		::AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+		GetLastError() == ERROR_SUCCESS;
+	::CloseHandle(token);
+	return result;
+}
+
+// Bump allocator over one reserved address range. Pages are committed in
+// commitStep chunks as the arena grows and Reset releases every allocation
+// at once. With largePages the whole range is committed up front on large
+// pages, falling back to normal pages if the privilege or the memory is not
+// available. numaNode selects the preferred node for the physical pages.
+// Not synchronized: use one arena per thread or per request.
+class VirtualArena {
+public:
+	explicit VirtualArena(SIZE_T reserve, bool largePages = false, DWORD numaNode = NUMA_NO_PREFERRED_NODE,
+		SIZE_T commitStep = 1024 * 1024) :
+		numaNode(numaNode)
+	{
+		SYSTEM_INFO info;
+		::GetSystemInfo(&info);
+		pageSize = info.dwPageSize;
+		this->commitStep = RoundUp(std::max<SIZE_T>(commitStep, 1), pageSize);
+		if (largePages) {
+			auto largePage = ::GetLargePageMinimum();
+			if (largePage != 0 && EnableLockMemoryPrivilege()) {
+				auto size = RoundUp(reserve, largePage);
+				base = static_cast<std::byte*>(Alloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES));
+				if (base) {
+					capacity = committed = size;
+					large = true;
+					return;
+				}
+			}
+		}
+		capacity = RoundUp(reserve, pageSize);
+		base = static_cast<std::byte*>(winapi_call(Alloc(nullptr, capacity, MEM_RESERVE)));
+	}
+	~VirtualArena() {
+		::VirtualFree(base, 0, MEM_RELEASE);
+	}
+	VirtualArena(const VirtualArena&) = delete;
+	VirtualArena& operator=(const VirtualArena&) = delete;
+	// Throws std::bad_alloc once the reservation is exhausted; alignment
+	// must be a power of two
+	void* Allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t)) {
+		auto address = reinterpret_cast<std::uintptr_t>(base) + offset;
+		auto start = offset + ((alignment - address % alignment) % alignment);
+		if (start > capacity || size > capacity - start) {
+			throw std::bad_alloc();
+		}
+		auto end = start + size;
+		if (end > committed) {
+			Commit(end);
+		}
+		offset = end;
+		return base + start;
+	}
+	// Releases every allocation; committed pages are kept for reuse
+	void Reset() noexcept {
+		offset = 0;
+	}
+	// Decommits pages beyond max(keep, Used()); large pages stay committed
+	void Trim(SIZE_T keep = 0) noexcept {
+		if (large) {
+			return;
+		}
+		keep = RoundUp(std::max<SIZE_T>(keep, offset), pageSize);
+		if (keep < committed) {
+			::VirtualFree(base + keep, committed - keep, MEM_DECOMMIT);
+			committed = keep;
+		}
+	}
+	void* Data() const noexcept { return base; }
+	SIZE_T Used() const noexcept { return offset; }
+	SIZE_T Committed() const noexcept { return committed; }
+	SIZE_T Capacity() const noexcept { return capacity; }
+	bool LargePages() const noexcept { return large; }
+private:
+	static SIZE_T RoundUp(SIZE_T value, SIZE_T multiple) noexcept {
+		return (value + multiple - 1) / multiple * multiple;
+	}
+	void* Alloc(void* address, SIZE_T size, DWORD type) const noexcept {
+		auto protect = PAGE_READWRITE;
+		if (numaNode == NUMA_NO_PREFERRED_NODE) {
+			return ::VirtualAlloc(address, size, type, protect);
+		}
+		return ::VirtualAllocExNuma(GetCurrentProcess(), address, size, type, protect, numaNode);
+	}
+	void Commit(SIZE_T end) {
+		auto target = std::min(RoundUp(end, commitStep), capacity);
+		winapi_call(Alloc(base + committed, target - committed, MEM_COMMIT));
+		committed = target;
+	}
+	std::byte* base = nullptr;
+	SIZE_T capacity = 0;
+	SIZE_T committed = 0;
+	SIZE_T offset = 0;
+	SIZE_T pageSize;
+	SIZE_T commitStep;
+	DWORD numaNode;
+	bool large = false;
+};
+
+// Lets std::pmr containers allocate from a VirtualArena; deallocation is a
+// no-op until the arena is reset
+class VirtualArenaResource : public std::pmr::memory_resource {
+public:
+	explicit VirtualArenaResource(VirtualArena& arena) noexcept : arena(arena) {}
+	VirtualArena& Arena() const noexcept { return arena; }
+private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		return arena.Allocate(bytes, alignment);
+	}
+	void do_deallocate(void*, std::size_t, std::size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+	VirtualArena& arena;
+};
+
+#endif
+
+}
+
+#endif // SWAL_VIRTUAL_ARENA_H
@@ -0,0 +1,157 @@
+#ifndef SWAL_WAITSET_H
+#define SWAL_WAITSET_H
+
+#include "win_headers.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include "error.h"
+#include "handle.h"
+
+namespace swal {
+
+#if _WIN32_WINNT >= 0x0600
+
+enum class WaitMode {
+	OneShot,
+	Persistent
+};
+
+// Waits on any number of handles through thread-pool waits, so there is no
+// MAXIMUM_WAIT_OBJECTS limit and no dedicated wait thread per 64 handles.
+// Signalled handles are reported to a callback (on a pool thread) or posted
+// to an IOCompletionPort as (WAIT_OBJECT_0 or WAIT_TIMEOUT, key, nullptr).
+// OneShot entries must be re-armed with Rearm after each notification;
+// Persistent entries re-arm automatically, which suits auto-reset events.
+// Remove must not be called from inside the callback.
+class WaitSet {
+	struct Entry;
+public:
+	using Id = Entry*;
+	using Callback = std::function<void(HANDLE handle, ULONG_PTR key, bool timedOut)>;
+	explicit WaitSet(Callback callback, PTP_CALLBACK_ENVIRON env = nullptr) :
+		callback(std::move(callback)), port(NULL), env(env) {}
+	template <typename T>
+	explicit WaitSet(const IOCompletionPortHandle<T>& port, PTP_CALLBACK_ENVIRON env = nullptr) :
+		port(static_cast<const T&>(port)), env(env) {}
+	~WaitSet() { Clear(); }
+	WaitSet(const WaitSet&) = delete;
+	WaitSet& operator=(const WaitSet&) = delete;
+	Id Add(HANDLE handle, ULONG_PTR key, WaitMode mode = WaitMode::OneShot, DWORD timeout = INFINITE) {
+		auto entry = std::make_unique<Entry>();
+		entry->set = this;
+		entry->handle = handle;
+		entry->key = key;
+		entry->mode = mode;
+		entry->timeout = timeout;
+		entry->wait = winapi_call(CreateThreadpoolWait(OnWait, entry.get(), env));
+		auto id = entry.get();
+		{
+			std::lock_guard lock(mutex);
+			try {
+				entries.emplace(id, std::move(entry));
+			} catch (...) {
+				CloseThreadpoolWait(id->wait);
+				throw;
+			}
+		}
+		Arm(*id);
+		return id;
+	}
+	template <typename T> requires std::is_base_of_v<WaitableHandle<T>, T>
+	Id Add(const T& obj, ULONG_PTR key, WaitMode mode = WaitMode::OneShot, DWORD timeout = INFINITE) {
+		return Add(static_cast<const Handle&>(obj).get(), key, mode, timeout);
+	}
+	void Rearm(Id id) const {
+		Arm(*id);
+	}
+	void Remove(Id id) {
+		std::unique_ptr<Entry> entry;
+		{
+			std::lock_guard lock(mutex);
+			auto it = entries.find(id);
+			if (it == entries.end()) {
+				return;
+			}
+			entry = std::move(it->second);
+			entries.erase(it);
+		}
+		Close(*entry);
+	}
+	void Clear() {
+		std::unordered_map<Entry*, std::unique_ptr<Entry>> removed;
+		{
+			std::lock_guard lock(mutex);
+			removed.swap(entries);
+		}
+		for (auto& [id, entry] : removed) {
+			Close(*entry);
+		}
+	}
+	std::size_t Size() const {
+		std::lock_guard lock(mutex);
+		return entries.size();
+	}
+private:
+	struct Entry {
+		WaitSet* set;
+		HANDLE handle;
+		ULONG_PTR key;
+		WaitMode mode;
+		DWORD timeout;
+		PTP_WAIT wait;
+		std::atomic<bool> removed = false;
+	};
+	static void Arm(Entry& entry) {
+		if (entry.timeout == INFINITE) {
+			SetThreadpoolWait(entry.wait, entry.handle, nullptr);
+			return;
+		}
+		ULARGE_INTEGER due;
+		due.QuadPart = ULONGLONG(-LONGLONG(entry.timeout) * 10000);
+		FILETIME ft;
+		ft.dwLowDateTime = due.LowPart;
+		ft.dwHighDateTime = due.HighPart;
+		SetThreadpoolWait(entry.wait, entry.handle, &ft);
+	}
+	static void Close(Entry& entry) {
+		entry.removed = true;
+		// a callback that missed the flag may re-arm once, hence two rounds
+		for (int i = 0; i < 2; ++i) {
+			SetThreadpoolWait(entry.wait, NULL, nullptr);
+			WaitForThreadpoolWaitCallbacks(entry.wait, TRUE);
+		}
+		CloseThreadpoolWait(entry.wait);
+	}
+	static void CALLBACK OnWait(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WAIT, TP_WAIT_RESULT result) {
+		auto& entry = *static_cast<Entry*>(context);
+		if (entry.removed) {
+			return;
+		}
+		entry.set->Deliver(entry, result == WAIT_TIMEOUT);
+		if (entry.mode == WaitMode::Persistent && !entry.removed) {
+			Arm(entry);
+		}
+	}
+	void Deliver(const Entry& entry, bool timedOut) noexcept {
+		if (port != NULL) {
+			::PostQueuedCompletionStatus(port, timedOut ? WAIT_TIMEOUT : WAIT_OBJECT_0, entry.key, nullptr);
+		} else {
+			callback(entry.handle, entry.key, timedOut);
+		}
+	}
+	Callback callback;
+	HANDLE port;
+	PTP_CALLBACK_ENVIRON env;
+	mutable std::mutex mutex;
+	std::unordered_map<Entry*, std::unique_ptr<Entry>> entries;
+};
+
+#endif
+
+}
+
+#endif // SWAL_WAITSET_H
@@ -10,6 +10,7 @@
 
 #include "win_headers.h"
 #include <string>
+#include <vector>
 #include "error.h"
 #include "enum_bitwise.h"
 #include "zero_or_resource.h"
@@ -124,6 +125,9 @@ public:
 	PaintDC BeginPaint() const {
 		return { *this };
 	}
+	BufferedPaintDC BeginPaint(PaintBuffer& buffer) const {
+		return { *this, buffer };
+	}
 	WindowDC GetDC() const {
 		return { *this };
 	}
@@ -167,6 +171,108 @@ public:
     }
 };
 
+// Collects InvalidateRect calls in user space and issues them once per Flush.
+// A new rectangle is merged into an accumulated one when their bounding box
+// wastes no more than a quarter of its area; when maxRects is reached the
+// cheapest pair is merged regardless.
+class DirtyRegion {
+public:
+	struct Stats {
+		std::size_t added = 0;
+		std::size_t flushed = 0;
+		std::size_t Coalesced() const { return added - flushed; }
+	};
+	explicit DirtyRegion(HWND hWnd, std::size_t maxRects = 4) : wnd(hWnd), maxRects(std::max<std::size_t>(maxRects, 1)) {
+		rects.reserve(this->maxRects + 1);
+	}
+	void Add(const RECT& rc) {
+		if (rc.left >= rc.right || rc.top >= rc.bottom) {
+			return;
+		}
+		++stats.added;
+		if (all) {
+			return;
+		}
+		RECT cur = rc;
+		for (std::size_t i = 0; i < rects.size();) {
+			if (Waste(rects[i], cur) * 4 <= Area(Union(rects[i], cur))) {
+				cur = Union(rects[i], cur);
+				rects[i] = rects.back();
+				rects.pop_back();
+				i = 0;
+			} else {
+				++i;
+			}
+		}
+		rects.push_back(cur);
+		while (rects.size() > maxRects) {
+			MergeCheapest();
+		}
+	}
+	void AddAll() {
+		++stats.added;
+		all = true;
+		rects.clear();
+	}
+	bool Empty() const { return !all && rects.empty(); }
+	std::size_t Flush(bool erase = true) {
+		std::size_t count = 0;
+		if (all) {
+			wnd.InvalidateRect(erase);
+			count = 1;
+		} else {
+			for (auto& rc : rects) {
+				wnd.InvalidateRect(rc, erase);
+			}
+			count = rects.size();
+		}
+		all = false;
+		rects.clear();
+		stats.flushed += count;
+		return count;
+	}
+	void Discard() {
+		all = false;
+		rects.clear();
+	}
+	const Stats& GetStats() const { return stats; }
+	void ResetStats() { stats = {}; }
+private:
+	static long long Area(const RECT& rc) {
+		return (long long)(rc.right - rc.left) * (rc.bottom - rc.top);
+	}
+	static RECT Union(const RECT& a, const RECT& b) {
+		return { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+	}
+	static long long Waste(const RECT& a, const RECT& b) {
+		RECT in = { std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom) };
+		long long overlap = (in.left < in.right && in.top < in.bottom) ? Area(in) : 0;
+		return Area(Union(a, b)) - (Area(a) + Area(b) - overlap);
+	}
+	void MergeCheapest() {
+		std::size_t bestI = 0, bestJ = 1;
+		long long best = Waste(rects[0], rects[1]);
+		for (std::size_t i = 0; i < rects.size(); ++i) {
+			for (std::size_t j = i + 1; j < rects.size(); ++j) {
+				auto waste = Waste(rects[i], rects[j]);
+				if (waste < best) {
+					best = waste;
+					bestI = i;
+					bestJ = j;
+				}
+			}
+		}
+		rects[bestI] = Union(rects[bestI], rects[bestJ]);
+		rects[bestJ] = rects.back();
+		rects.pop_back();
+	}
+	Wnd wnd;
+	std::size_t maxRects;
+	std::vector<RECT> rects;
+	bool all = false;
+	Stats stats;
+};
+
 class Window : public Wnd {
 public:
     Window(HWND wnd = NULL) : Wnd(wnd) {}
@@ -0,0 +1,38 @@
+/*
+ * check.h
+ *
+ * Assertion for the tests that stays active in release builds
+ */
+
+#ifndef SWAL_TESTS_CHECK_H
+#define SWAL_TESTS_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <system_error>
+
+[[noreturn]] inline void check_failed(const char* condition, const char* file, int line) {
+	std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+	std::abort();
+}
+
+#define CHECK(condition) ((condition) ? void(0) : check_failed(#condition, __FILE__, __LINE__))
+
+// Checks that f throws std::system_error with the given code
+template <typename F>
+void check_throws(F&& f, std::error_code code, const char* file, int line) {
+	try {
+		f();
+	} catch (const std::system_error& e) {
+		if (e.code() != code) {
+			std::fprintf(stderr, "%s:%d: unexpected error: %s\n", file, line, e.what());
+			std::abort();
+		}
+		return;
+	}
+	check_failed("no exception thrown", file, line);
+}
+
+#define CHECK_THROWS(expression, code) check_throws([&]{ expression; }, code, __FILE__, __LINE__)
+
+#endif // SWAL_TESTS_CHECK_H
@@ -0,0 +1,153 @@
+#include <swal/ioctl.h>
+#include <swal/pipe.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "check.h"
+
+namespace {
+
+constexpr ULONG_PTR IoctlKey = 1;
+constexpr ULONG_PTR OtherKey = 2;
+constexpr DWORD Timeout = 10000;
+
+// The same control code ConnectNamedPipe issues: it stays pending until a
+// client opens the pipe, so it exercises both inline and queued completion
+using PipeListen = swal::Ioctl<FSCTL_PIPE_LISTEN>;
+
+// Coroutine that runs as soon as it is called and is not awaited
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+// Outcome of one awaited IOCTL: the error it threw, if any, and the thread
+// that was running when it finished
+struct Result {
+	bool done = false;
+	DWORD error = ERROR_SUCCESS;
+	std::thread::id thread;
+};
+
+template <typename I>
+Detached Await(HANDLE file, Result& result) {
+	try {
+		if constexpr (std::is_void_v<typename I::output>) {
+			co_await swal::AsyncIoctl<I>(file);
+		} else {
+			[[maybe_unused]] auto output = co_await swal::AsyncIoctl<I>(file);
+		}
+	} catch (const std::system_error& e) {
+		CHECK(e.code().category() == std::error_code(swal::win32_errc(ERROR_SUCCESS)).category());
+		result.error = DWORD(e.code().value());
+	}
+	result.thread = std::this_thread::get_id();
+	result.done = true;
+}
+
+swal::tstring UniqueName() {
+	static int counter = 0;
+#ifdef _WIN32
+	auto process = GetCurrentProcessId();
+#else
+	auto process = getpid();
+#endif
+#ifdef UNICODE
+	auto number = [](auto n) { return std::to_wstring(n); };
+#else
+	auto number = [](auto n) { return std::to_string(n); };
+#endif
+	return TEXT("\\\\.\\pipe\\swal-test-ioctl-") + number(process) + TEXT("-") + number(++counter);
+}
+
+struct Fixture {
+	swal::tstring name = UniqueName();
+	swal::NamedPipe server{ name, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+		PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT, 1 };
+	swal::IOCompletionPort port;
+	swal::IoDispatcher dispatcher{ port, IoctlKey };
+	Fixture() {
+		dispatcher.Associate(server);
+	}
+	swal::File Connect() const {
+		return swal::File(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+	}
+	void Dispatch() const {
+		auto status = port.GetQueuedCompletionStatus(Timeout);
+		CHECK(status.ovl != nullptr);
+		CHECK(dispatcher.HandleCompletion(status));
+	}
+	// Failures that are reported at once must not queue a packet too
+	void CheckIdle() const {
+		CHECK(port.GetQueuedCompletionStatus(0).error == WAIT_TIMEOUT);
+	}
+};
+
+void TestAwait() {
+	Fixture fixture;
+	Result listen;
+	Await<PipeListen>(fixture.server, listen);
+	CHECK(!listen.done);
+	auto client = fixture.Connect();
+	// packets of other keys are left to their owners
+	CHECK(!fixture.dispatcher.HandleCompletion({ ERROR_SUCCESS, 0, OtherKey, nullptr }));
+	fixture.Dispatch();
+	CHECK(listen.done && listen.error == ERROR_SUCCESS);
+	CHECK(listen.thread == std::this_thread::get_id());
+
+	// an error returned by the call resumes the coroutine without a packet
+	Result again;
+	Await<PipeListen>(fixture.server, again);
+	CHECK(again.done && again.error == ERROR_PIPE_CONNECTED);
+	Result unsupported;
+	Await<swal::DiskGetLengthInfo>(fixture.server, unsupported);
+	CHECK(unsupported.done && unsupported.error == ERROR_INVALID_FUNCTION);
+	fixture.CheckIdle();
+}
+
+void TestBegin() {
+	Fixture fixture;
+	std::optional<DWORD> listened;
+	swal::BeginIoctl<PipeListen>(fixture.server, [&](DWORD error) { listened = error; });
+	CHECK(!listened);
+	auto client = fixture.Connect();
+	fixture.Dispatch();
+	CHECK(listened == DWORD(ERROR_SUCCESS));
+
+	// a request that cannot start throws and never calls back
+	bool called = false;
+	CHECK_THROWS(swal::BeginIoctl<PipeListen>(fixture.server, [&](DWORD) { called = true; }),
+		swal::win32_errc(ERROR_PIPE_CONNECTED));
+	CHECK_THROWS(swal::BeginIoctl<swal::DiskGetLengthInfo>(fixture.server,
+		[&](DWORD, GET_LENGTH_INFORMATION&) { called = true; }), swal::win32_errc(ERROR_INVALID_FUNCTION));
+	fixture.CheckIdle();
+	CHECK(!called);
+
+	// a cancelled request still completes through the port
+	fixture.server.Disconnect();
+	listened.reset();
+	swal::BeginIoctl<PipeListen>(fixture.server, [&](DWORD error) { listened = error; });
+	CHECK(!listened);
+	CHECK(CancelIoEx(fixture.server, nullptr));
+	fixture.Dispatch();
+	CHECK(listened == DWORD(ERROR_OPERATION_ABORTED));
+}
+
+}
+
+int main() {
+	TestAwait();
+	TestBegin();
+}
@@ -0,0 +1,124 @@
+// Times the pixels.h kernels against per-channel scalar loops after checking
+// that both agree. Usage: pixels_bench [width] [height] [repetitions]
+#include <swal/pixels.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::uint32_t ReferenceBlend(std::uint32_t dst, std::uint32_t src) {
+	std::uint32_t ia = 255 - (src >> 24);
+	std::uint32_t result = 0;
+	for (int shift = 0; shift < 32; shift += 8) {
+		std::uint32_t d = (dst >> shift) & 0xFF;
+		std::uint32_t s = (src >> shift) & 0xFF;
+		result |= (s + (d * ia + 127) / 255) << shift;
+	}
+	return result;
+}
+
+std::uint32_t ReferenceRgba(std::uint32_t px) {
+	std::uint32_t b = px & 0xFF, g = (px >> 8) & 0xFF, r = (px >> 16) & 0xFF;
+	return r | g << 8 | b << 16 | 0xFF000000;
+}
+
+// Random premultiplied pixel, so that no channel exceeds its alpha
+std::uint32_t RandomPixel(std::mt19937& rng) {
+	std::uint32_t a = rng() & 0xFF;
+	auto channel = [&] { return a ? std::uint8_t(rng() % (a + 1)) : std::uint8_t(0); };
+	return swal::Bgra(channel(), channel(), channel(), std::uint8_t(a));
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	std::size_t width = argc > 1 ? std::size_t(std::atoi(argv[1])) : 1920;
+	std::size_t height = argc > 2 ? std::size_t(std::atoi(argv[2])) : 1080;
+	int repetitions = argc > 3 ? std::atoi(argv[3]) : 20;
+	// the odd stride keeps the row loops from being merged into one span
+	std::size_t stride = width + 7;
+	std::mt19937 rng(1);
+	std::vector<std::uint32_t> background(stride * height), source(stride * height);
+	for (auto& px : background) {
+		px = RandomPixel(rng);
+	}
+	for (auto& px : source) {
+		px = RandomPixel(rng);
+	}
+	auto color = swal::Bgra(40, 80, 120, 160);
+	std::vector<std::uint32_t> target(stride * height), expected(stride * height);
+	swal::pixel_view view(target.data(), width, height, stride);
+	swal::const_pixel_view src(source.data(), width, height, stride);
+
+	struct Kernel {
+		const char* name;
+		void (*run)(swal::pixel_view dst, swal::const_pixel_view src, std::uint32_t color);
+		std::uint32_t (*reference)(std::uint32_t dst, std::uint32_t src, std::uint32_t color);
+	};
+	const Kernel kernels[] = {
+		{ "fill", [](swal::pixel_view dst, swal::const_pixel_view, std::uint32_t c) { swal::fill_pixels(dst, c); },
+			[](std::uint32_t, std::uint32_t, std::uint32_t c) { return c; } },
+		{ "copy", [](swal::pixel_view dst, swal::const_pixel_view s, std::uint32_t) { swal::copy_pixels(dst, s); },
+			[](std::uint32_t, std::uint32_t s, std::uint32_t) { return s; } },
+		{ "blend", [](swal::pixel_view dst, swal::const_pixel_view s, std::uint32_t) { swal::blend_pixels(dst, s); },
+			[](std::uint32_t d, std::uint32_t s, std::uint32_t) { return ReferenceBlend(d, s); } },
+		{ "blend color", [](swal::pixel_view dst, swal::const_pixel_view, std::uint32_t c) { swal::blend_pixels(dst, c); },
+			[](std::uint32_t d, std::uint32_t, std::uint32_t c) { return ReferenceBlend(d, c); } },
+		{ "to rgba", [](swal::pixel_view dst, swal::const_pixel_view, std::uint32_t) {
+				for (std::size_t y = 0; y < dst.height; ++y) {
+					swal::convert_bgra_to_rgba(dst.row(y));
+				}
+			},
+			[](std::uint32_t d, std::uint32_t, std::uint32_t) { return ReferenceRgba(d); } },
+	};
+
+	int failed = 0;
+	std::printf("%-12s %12s %12s %8s\n", "kernel", "Mpx/s", "scalar Mpx/s", "speedup");
+	for (auto& kernel : kernels) {
+		target = background;
+		kernel.run(view, src, color);
+		for (std::size_t y = 0; y < height; ++y) {
+			for (std::size_t x = 0; x < width; ++x) {
+				auto i = y * stride + x;
+				expected[i] = kernel.reference(background[i], source[i], color);
+			}
+		}
+		for (std::size_t y = 0; y < height; ++y) {
+			for (std::size_t x = 0; x < width; ++x) {
+				auto i = y * stride + x;
+				if (target[i] != expected[i]) {
+					std::printf("%s: pixel (%zu, %zu) is %08X, expected %08X\n", kernel.name, x, y,
+						unsigned(target[i]), unsigned(expected[i]));
+					++failed;
+					y = height;
+					break;
+				}
+			}
+		}
+		// each timing starts from the same background
+		auto time = [&](auto&& body) {
+			target = background;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < repetitions; ++i) {
+				body();
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			return double(width * height) * repetitions / elapsed.count() / 1e6;
+		};
+		auto fast = time([&] { kernel.run(view, src, color); });
+		auto scalar = time([&] {
+			for (std::size_t y = 0; y < height; ++y) {
+				for (std::size_t x = 0; x < width; ++x) {
+					auto i = y * stride + x;
+					target[i] = kernel.reference(target[i], source[i], color);
+				}
+			}
+		});
+		std::printf("%-12s %12.1f %12.1f %7.1fx\n", kernel.name, fast, scalar, fast / scalar);
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
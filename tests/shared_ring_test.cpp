@@ -0,0 +1,186 @@
+#include <swal/shared_ring.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "check.h"
+
+namespace {
+
+swal::tstring UniqueName() {
+	static int counter = 0;
+#ifdef _WIN32
+	auto process = GetCurrentProcessId();
+#else
+	auto process = getpid();
+#endif
+#ifdef UNICODE
+	auto number = [](auto n) { return std::to_wstring(n); };
+#else
+	auto number = [](auto n) { return std::to_string(n); };
+#endif
+	return TEXT("swal-test-ring-") + number(process) + TEXT("-") + number(++counter);
+}
+
+// Message i has a length that cycles through 0..max and a byte pattern
+// derived from i, so that a reader can tell torn or reordered records
+std::vector<std::byte> MakeMessage(std::size_t i, std::size_t max) {
+	std::vector<std::byte> message(i % (max + 1));
+	for (std::size_t j = 0; j < message.size(); ++j) {
+		message[j] = std::byte((i * 31 + j) & 0xFF);
+	}
+	return message;
+}
+
+bool IsMessage(std::span<const std::byte> message, std::size_t i, std::size_t max) {
+	auto expected = MakeMessage(i, max);
+	return std::equal(message.begin(), message.end(), expected.begin(), expected.end());
+}
+
+template <typename Ring>
+void Produce(Ring& ring, std::size_t count, std::size_t max) {
+	for (std::size_t i = 0; i < count; ++i) {
+		auto message = MakeMessage(i, max);
+		CHECK(ring.Write(message, 10000));
+	}
+}
+
+template <typename Ring>
+void Consume(Ring& ring, std::size_t count, std::size_t max) {
+	for (std::size_t i = 0; i < count; ++i) {
+		bool matches = false;
+		CHECK(ring.Read([&](std::span<const std::byte> message) { matches = IsMessage(message, i, max); }, 10000));
+		CHECK(matches);
+	}
+	CHECK(!ring.TryRead([](std::span<const std::byte>) {}));
+}
+
+void TestSpscThreads(unsigned spinCount) {
+	constexpr std::size_t count = 20000;
+	auto name = UniqueName();
+	swal::SpscRing consumer(name, 256);
+	consumer.SetSpinCount(spinCount);
+	auto max = consumer.MaxMessageSize();
+	std::thread producer([&] {
+		swal::SpscRing ring(name);
+		ring.SetSpinCount(spinCount);
+		Produce(ring, count, max);
+	});
+	Consume(consumer, count, max);
+	producer.join();
+}
+
+#ifndef _WIN32
+void TestSpscProcesses() {
+	constexpr std::size_t count = 20000;
+	auto name = UniqueName();
+	swal::SpscRing consumer(name, 4096);
+	auto max = consumer.MaxMessageSize();
+	auto child = fork();
+	CHECK(child >= 0);
+	if (child == 0) {
+		int status = 0;
+		try {
+			swal::SpscRing ring(name);
+			Produce(ring, count, max);
+		} catch (...) {
+			status = 1;
+		}
+		_exit(status);
+	}
+	Consume(consumer, count, max);
+	int status;
+	CHECK(waitpid(child, &status, 0) == child);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+#endif
+
+void TestMpsc() {
+	constexpr unsigned producers = 4;
+	constexpr std::uint32_t count = 20000;
+	auto name = UniqueName();
+	swal::MpscRing consumer(name, 1024);
+	std::vector<std::thread> threads;
+	for (unsigned p = 0; p < producers; ++p) {
+		threads.emplace_back([&, p] {
+			swal::MpscRing ring(name);
+			for (std::uint32_t i = 0; i < count; ++i) {
+				std::uint32_t record[2] = { p, i };
+				CHECK(ring.Write(std::as_bytes(std::span(record)), 10000));
+			}
+		});
+	}
+	std::uint32_t next[producers] = {};
+	for (std::uint32_t i = 0; i < producers * count; ++i) {
+		CHECK(consumer.Read([&](std::span<const std::byte> message) {
+			std::uint32_t record[2];
+			CHECK(message.size() == sizeof(record));
+			std::memcpy(record, message.data(), sizeof(record));
+			CHECK(record[0] < producers);
+			// each producer's messages arrive in the order it wrote them
+			CHECK(record[1] == next[record[0]]++);
+		}, 10000));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (auto received : next) {
+		CHECK(received == count);
+	}
+}
+
+void TestTimeouts() {
+	swal::SpscRing ring(UniqueName(), 64);
+	CHECK(ring.Capacity() == 64);
+	auto start = GetTickCount64();
+	CHECK(!ring.Read([](std::span<const std::byte>) {}, 50));
+	CHECK(GetTickCount64() - start >= 40);
+	std::vector<std::byte> message(ring.MaxMessageSize());
+	CHECK(ring.TryWrite(message));
+	CHECK(ring.TryWrite(message));
+	CHECK(!ring.Write(message, 50));
+	std::vector<std::byte> tooLarge(ring.MaxMessageSize() + 1);
+	CHECK_THROWS(ring.TryWrite(tooLarge), swal::win32_errc(ERROR_INVALID_PARAMETER));
+}
+
+void TestAttach() {
+	auto name = UniqueName();
+	swal::SpscRing ring(name, 100);
+	CHECK(ring.Capacity() == 128);
+	// a second creator keeps the existing capacity
+	swal::SpscRing same(name, 1 << 20);
+	CHECK(same.Capacity() == 128);
+	CHECK_THROWS(swal::MpscRing{ name }, swal::win32_errc(ERROR_INVALID_DATA));
+	// a capacity that does not fit in the mapping must not be trusted
+	swal::FileMapping mapping(FILE_MAP_READ | FILE_MAP_WRITE, false, name);
+	auto view = mapping.Map(FILE_MAP_READ | FILE_MAP_WRITE);
+	auto header = view.As<swal::SharedRingHeader>();
+	header->capacity = 1 << 20;
+	CHECK_THROWS(swal::SpscRing{ name }, swal::win32_errc(ERROR_INVALID_DATA));
+	header->capacity = 96;
+	CHECK_THROWS(swal::SpscRing{ name }, swal::win32_errc(ERROR_INVALID_DATA));
+	header->capacity = 128;
+	CHECK(swal::SpscRing{ name }.Capacity() == 128);
+	CHECK_THROWS(swal::SpscRing{ UniqueName() }, swal::win32_errc(ERROR_FILE_NOT_FOUND));
+}
+
+}
+
+int main() {
+	TestSpscThreads(4000);
+	// without spinning every wait goes through the events
+	TestSpscThreads(0);
+#ifndef _WIN32
+	TestSpscProcesses();
+#endif
+	TestMpsc();
+	TestTimeouts();
+	TestAttach();
+}
@@ -0,0 +1,345 @@
+#include <swal/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+constexpr ULONG_PTR AcceptKey = 1;
+constexpr ULONG_PTR EchoKey = 2;
+constexpr ULONG_PTR QuitKey = 3;
+constexpr DWORD Timeout = 10000;
+
+sockaddr_in Loopback() {
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return address;
+}
+
+sockaddr_in LocalAddress(const swal::Socket& socket) {
+	sockaddr_in address;
+	int length = sizeof(address);
+	CHECK(getsockname(socket, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+	return address;
+}
+
+std::vector<std::byte> MakeMessage(std::size_t size, std::size_t seed) {
+	std::vector<std::byte> message(size);
+	for (std::size_t i = 0; i < size; ++i) {
+		message[i] = std::byte((i * 7 + seed) & 0xFF);
+	}
+	return message;
+}
+
+// Sends back what it receives until the peer shuts down its side. Runs the
+// next operation at once when one completes inline with
+// SkipCompletionPortOnSuccess in effect.
+struct Echo {
+	struct Op : OVERLAPPED {
+		Echo* echo;
+	};
+	swal::Socket socket;
+	std::atomic<int>& open;
+	bool skip = false;
+	Op recvOp;
+	Op sendOp;
+	std::vector<std::byte> buffer = std::vector<std::byte>(65536);
+	DWORD size = 0;
+	Echo(swal::Socket s, std::atomic<int>& open) : socket(std::move(s)), open(open) {
+		recvOp.echo = this;
+		sendOp.echo = this;
+	}
+	void Start(const swal::IOCompletionPort& port) {
+		port.AssocFile(socket.AsHandle(), EchoKey);
+		skip = socket.SkipCompletionPortOnSuccess();
+		++open;
+		Issue(false);
+	}
+	void OnCompletion(const swal::CompletionStatusResult& status) {
+		CHECK(status.error == ERROR_SUCCESS);
+		bool send = status.ovl == &sendOp;
+		if (Next(send, status.bytesTransfered)) {
+			Issue(send);
+		}
+	}
+	void Issue(bool send) {
+		for (;;) {
+			std::optional<DWORD> done;
+			if (send) {
+				static_cast<OVERLAPPED&>(sendOp) = {};
+				done = socket.Send(std::span<const std::byte>(buffer.data(), size), sendOp);
+			} else {
+				static_cast<OVERLAPPED&>(recvOp) = {};
+				done = socket.Recv(buffer, recvOp);
+			}
+			if (!done || !skip || !Next(send, *done)) {
+				return;
+			}
+		}
+	}
+	// Picks the operation after one that completed; returns false once the
+	// peer has shut down
+	bool Next(bool& send, DWORD bytes) {
+		if (send) {
+			CHECK(bytes == size);
+			send = false;
+			return true;
+		}
+		if (bytes == 0) {
+			socket = swal::Socket();
+			--open;
+			return false;
+		}
+		size = bytes;
+		send = true;
+		return true;
+	}
+};
+
+// Echo server on an ephemeral loopback port, dispatched by one thread
+struct Server {
+	swal::IOCompletionPort port;
+	sockaddr_in address;
+	std::atomic<swal::AcceptPool*> pool = nullptr;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Echo>> echoes;
+	std::set<std::uint16_t> clientPorts;
+	std::atomic<int> open = 0;
+	std::atomic<std::size_t> accepted = 0;
+	std::thread dispatcher;
+	explicit Server(std::size_t depth) {
+		swal::Socket listener(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		auto loopback = Loopback();
+		listener.Bind(reinterpret_cast<const sockaddr*>(&loopback), sizeof(loopback));
+		listener.Listen();
+		address = LocalAddress(listener);
+		pool = new swal::AcceptPool(port, AcceptKey, std::move(listener), depth,
+			[this](swal::Socket socket, const sockaddr* local, const sockaddr* remote) {
+				OnAccept(std::move(socket), local, remote);
+			});
+		dispatcher = std::thread([this] { Dispatch(); });
+	}
+	~Server() {
+		CloseListener();
+		port.PostQueuedCompletionStatus(0, QuitKey, nullptr);
+		dispatcher.join();
+	}
+	// The pool can only be destroyed while its completions are dispatched
+	void CloseListener() {
+		delete pool.load();
+		pool = nullptr;
+	}
+	void OnAccept(swal::Socket socket, const sockaddr* local, const sockaddr* remote) {
+		CHECK(local->sa_family == AF_INET && remote->sa_family == AF_INET);
+		auto localIn = reinterpret_cast<const sockaddr_in*>(local);
+		auto remoteIn = reinterpret_cast<const sockaddr_in*>(remote);
+		CHECK(localIn->sin_port == address.sin_port);
+		CHECK(remoteIn->sin_addr.s_addr == htonl(INADDR_LOOPBACK));
+		auto echo = std::make_unique<Echo>(std::move(socket), open);
+		auto& started = *echo;
+		{
+			std::lock_guard lock(mutex);
+			clientPorts.insert(ntohs(remoteIn->sin_port));
+			echoes.push_back(std::move(echo));
+		}
+		started.Start(port);
+		++accepted;
+	}
+	void Dispatch() {
+		for (;;) {
+			auto status = port.GetQueuedCompletionStatus(INFINITE);
+			if (status.key == QuitKey) {
+				return;
+			}
+			if (status.key == AcceptKey) {
+				CHECK(pool.load()->HandleCompletion(status));
+			} else {
+				CHECK(status.key == EchoKey && status.ovl != nullptr);
+				static_cast<Echo::Op&>(*status.ovl).echo->OnCompletion(status);
+			}
+		}
+	}
+	std::set<std::uint16_t> ClientPorts() {
+		std::lock_guard lock(mutex);
+		return clientPorts;
+	}
+	// Waits until count connections have been accepted and closed again
+	void WaitClosed(std::size_t count) {
+		auto deadline = GetTickCount64() + Timeout;
+		while (accepted != count || open != 0) {
+			CHECK(GetTickCount64() < deadline);
+			Sleep(1);
+		}
+	}
+};
+
+swal::CompletionStatusResult WaitFor(const swal::IOCompletionPort& port, const OVERLAPPED& ovl) {
+	auto status = port.GetQueuedCompletionStatus(Timeout);
+	CHECK(status.ovl == &ovl);
+	return status;
+}
+
+// Waits for the packet of an operation unless it completed inline and
+// skipped the port
+DWORD Complete(const swal::IOCompletionPort& port, std::optional<DWORD> done, bool skip, const OVERLAPPED& ovl) {
+	if (done && skip) {
+		return *done;
+	}
+	auto status = WaitFor(port, ovl);
+	CHECK(status.error == ERROR_SUCCESS);
+	CHECK(!done || status.bytesTransfered == *done);
+	return status.bytesTransfered;
+}
+
+struct Client {
+	swal::Socket socket{ AF_INET, SOCK_STREAM, IPPROTO_TCP };
+	bool skip = false;
+	Client(const swal::IOCompletionPort& port, ULONG_PTR key, bool skipOnSuccess) {
+		socket.BindAny(AF_INET);
+		port.AssocFile(socket.AsHandle(), key);
+		skip = skipOnSuccess && socket.SkipCompletionPortOnSuccess();
+	}
+	std::optional<DWORD> Connect(const sockaddr_in& address, OVERLAPPED& ovl) {
+		return socket.Connect(reinterpret_cast<const sockaddr*>(&address), sizeof(address), ovl);
+	}
+};
+
+// Sends a message while receiving its echo, so that neither side's buffers
+// fill up while the other waits
+void Exchange(const swal::IOCompletionPort& port, Client& client, std::size_t size, std::size_t seed) {
+	auto message = MakeMessage(size, seed);
+	std::vector<std::byte> received(size);
+	std::size_t got = 0;
+	OVERLAPPED sendOvl = {}, recvOvl = {};
+	bool sending = true;
+	auto sent = client.socket.Send(message, sendOvl);
+	if (sent && client.skip) {
+		CHECK(*sent == size);
+		sending = false;
+	}
+	auto receive = [&] {
+		for (;;) {
+			recvOvl = {};
+			auto done = client.socket.Recv(std::span(received).subspan(got), recvOvl);
+			if (!done || !client.skip) {
+				return;
+			}
+			CHECK(*done != 0);
+			got += *done;
+			if (got == size) {
+				return;
+			}
+		}
+	};
+	receive();
+	while (sending || got < size) {
+		auto status = port.GetQueuedCompletionStatus(Timeout);
+		CHECK(status.error == ERROR_SUCCESS && status.ovl != nullptr);
+		if (status.ovl == &sendOvl) {
+			CHECK(sending && status.bytesTransfered == size);
+			sending = false;
+		} else {
+			CHECK(status.ovl == &recvOvl && status.bytesTransfered != 0);
+			got += status.bytesTransfered;
+			if (got < size) {
+				receive();
+			}
+		}
+	}
+	CHECK(received == message);
+	// every inline completion was queued exactly once, or not at all
+	CHECK(port.GetQueuedCompletionStatus(0).error == WAIT_TIMEOUT);
+}
+
+void TestEcho() {
+	constexpr std::size_t sizes[] = { 1, 1000, 100000, 4 * 1024 * 1024 };
+	Server server(4);
+	swal::IOCompletionPort port;
+	std::vector<std::unique_ptr<Client>> clients;
+	std::set<std::uint16_t> clientPorts;
+	for (std::size_t i = 0; i < 2 * std::size(sizes); ++i) {
+		auto& client = *clients.emplace_back(std::make_unique<Client>(port, i, i % 2 != 0));
+		OVERLAPPED ovl = {};
+		Complete(port, client.Connect(server.address, ovl), client.skip, ovl);
+		client.socket.FinishConnect();
+		clientPorts.insert(ntohs(LocalAddress(client.socket).sin_port));
+	}
+	for (std::size_t i = 0; i < clients.size(); ++i) {
+		Exchange(port, *clients[i], sizes[i / 2], i);
+	}
+	// the server closes its side once the client has shut down its own
+	for (auto& client : clients) {
+		client->socket.Shutdown(SD_SEND);
+		std::byte byte;
+		OVERLAPPED ovl = {};
+		CHECK(Complete(port, client->socket.Recv(std::span(&byte, 1), ovl), client->skip, ovl) == 0);
+	}
+	server.WaitClosed(clients.size());
+	CHECK(server.ClientPorts() == clientPorts);
+	CHECK(server.pool.load()->Active() == 4);
+}
+
+void TestStop() {
+	Server server(8);
+	auto pool = server.pool.load();
+	CHECK(pool->Active() == 8);
+	pool->Stop();
+	auto deadline = GetTickCount64() + Timeout;
+	while (pool->Active() != 0) {
+		CHECK(GetTickCount64() < deadline);
+		Sleep(1);
+	}
+	// the listener stays open until the pool is destroyed, but nothing
+	// accepts any more; a pool that is destroyed without Stop cancels too
+	Server other(2);
+	auto address = other.address;
+	other.CloseListener();
+	swal::IOCompletionPort port;
+	Client client(port, 0, false);
+	OVERLAPPED ovl = {};
+	try {
+		client.Connect(address, ovl);
+		auto status = WaitFor(port, ovl);
+		CHECK(status.error == WSAECONNREFUSED);
+	} catch (const std::system_error& e) {
+		CHECK(e.code() == std::error_code(swal::win32_errc(WSAECONNREFUSED)));
+	}
+}
+
+void TestCancel() {
+	Server server(1);
+	swal::IOCompletionPort port;
+	Client client(port, 0, true);
+	OVERLAPPED ovl = {};
+	Complete(port, client.Connect(server.address, ovl), client.skip, ovl);
+	client.socket.FinishConnect();
+	// nothing arrives, so the receive stays pending until cancelled
+	std::byte byte;
+	ovl = {};
+	CHECK(!client.socket.Recv(std::span(&byte, 1), ovl));
+	CHECK(CancelIoEx(client.socket.AsHandle(), &ovl));
+	auto status = WaitFor(port, ovl);
+	CHECK(status.error == ERROR_OPERATION_ABORTED && status.bytesTransfered == 0);
+	CHECK(!CancelIoEx(client.socket.AsHandle(), &ovl) && GetLastError() == ERROR_NOT_FOUND);
+	client.socket.Shutdown(SD_SEND);
+	server.WaitClosed(1);
+}
+
+}
+
+int main() {
+	swal::WSAInitializer wsa;
+	TestEcho();
+	TestStop();
+	TestCancel();
+}
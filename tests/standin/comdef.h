@@ -0,0 +1,28 @@
+/*
+ * comdef.h
+ *
+ * POSIX stand-in, see windows.h
+ */
+
+#ifndef SWAL_STANDIN_COMDEF_H
+#define SWAL_STANDIN_COMDEF_H
+
+#include <windows.h>
+#include <cstdio>
+#include <string>
+
+class _com_error {
+public:
+	explicit _com_error(HRESULT hr) : hr(hr) {
+		char text[32];
+		std::snprintf(text, sizeof(text), "COM error 0x%08X", unsigned(hr));
+		message = text;
+	}
+	HRESULT Error() const noexcept { return hr; }
+	const TCHAR* ErrorMessage() const noexcept { return message.c_str(); }
+private:
+	HRESULT hr;
+	std::string message;
+};
+
+#endif // SWAL_STANDIN_COMDEF_H
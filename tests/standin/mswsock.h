@@ -0,0 +1,12 @@
+/*
+ * mswsock.h
+ *
+ * POSIX stand-in; the extension functions are implemented in winsock2.h.
+ */
+
+#ifndef SWAL_STANDIN_MSWSOCK_H
+#define SWAL_STANDIN_MSWSOCK_H
+
+#include <winsock2.h>
+
+#endif // SWAL_STANDIN_MSWSOCK_H
@@ -0,0 +1,12 @@
+/*
+ * objbase.h
+ *
+ * POSIX stand-in, see windows.h; nothing the tests use lives here
+ */
+
+#ifndef SWAL_STANDIN_OBJBASE_H
+#define SWAL_STANDIN_OBJBASE_H
+
+#include <windows.h>
+
+#endif // SWAL_STANDIN_OBJBASE_H
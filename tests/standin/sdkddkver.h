@@ -0,0 +1,16 @@
+/*
+ * sdkddkver.h
+ *
+ * POSIX stand-in, see windows.h
+ */
+
+#ifndef SWAL_STANDIN_SDKDDKVER_H
+#define SWAL_STANDIN_SDKDDKVER_H
+
+#define _WIN32_WINNT_VISTA 0x0600
+#define _WIN32_WINNT_WIN7 0x0601
+#define _WIN32_WINNT_WIN8 0x0602
+#define _WIN32_WINNT_WINBLUE 0x0603
+#define _WIN32_WINNT_WIN10 0x0A00
+
+#endif // SWAL_STANDIN_SDKDDKVER_H
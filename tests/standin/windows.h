@@ -0,0 +1,1716 @@
+/*
+ * windows.h
+ *
+ * POSIX stand-in for the parts of the Windows API that the tests exercise,
+ * so that they can run on Linux. Kernel objects are reference-counted C++
+ * objects behind HANDLE; named objects live in POSIX shared memory so that
+ * they work across fork(), and waits sleep on a futex. APIs the tests do
+ * not reach are only declared and fail to link if one starts using them.
+ */
+
+#ifndef SWAL_STANDIN_WINDOWS_H
+#define SWAL_STANDIN_WINDOWS_H
+
+#ifdef UNICODE
+#error "the stand-in only implements the ANSI character set"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned char UCHAR;
+typedef unsigned char BOOLEAN;
+typedef char CHAR;
+typedef char CCHAR;
+typedef wchar_t WCHAR;
+typedef unsigned short WORD;
+typedef int INT;
+typedef int* LPINT;
+typedef int LONG;
+typedef unsigned int UINT;
+typedef unsigned int ULONG;
+typedef unsigned int DWORD;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned long long DWORD64;
+typedef std::intptr_t INT_PTR;
+typedef std::intptr_t LONG_PTR;
+typedef std::uintptr_t UINT_PTR;
+typedef std::uintptr_t ULONG_PTR;
+typedef std::uintptr_t DWORD_PTR;
+typedef ULONG_PTR* PULONG_PTR;
+typedef std::size_t SIZE_T;
+typedef LONG HRESULT;
+typedef DWORD COLORREF;
+typedef DWORD* LPDWORD;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef void* HANDLE;
+typedef HANDLE* PHANDLE;
+typedef char TCHAR;
+typedef char* LPSTR;
+typedef const char* LPCSTR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef TCHAR* LPTSTR;
+typedef const TCHAR* LPCTSTR;
+
+#define VOID void
+#define WINAPI
+#define CALLBACK
+#define PASCAL
+#define TRUE 1
+#define FALSE 0
+#ifndef NULL
+#define NULL nullptr
+#endif
+#define TEXT(text) text
+#define MAXDWORD 0xFFFFFFFFu
+#define INFINITE 0xFFFFFFFFu
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(LONG_PTR(-1)))
+#define FAILED(hr) (HRESULT(hr) < 0)
+#define SUCCEEDED(hr) (HRESULT(hr) >= 0)
+#define MAKELANGID(primary, sub) ((WORD(sub) << 10) | WORD(primary))
+#define LANG_ENGLISH 0x09
+#define SUBLANG_ENGLISH_US 0x01
+#define CP_ACP 0
+#define CP_UTF8 65001
+#define CLR_INVALID 0xFFFFFFFFu
+
+#define ERROR_SUCCESS 0
+#define ERROR_INVALID_FUNCTION 1
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_PATH_NOT_FOUND 3
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_INVALID_HANDLE 6
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_INVALID_DATA 13
+#define ERROR_OUTOFMEMORY 14
+#define ERROR_NO_MORE_FILES 18
+#define ERROR_GEN_FAILURE 31
+#define ERROR_HANDLE_EOF 38
+#define ERROR_NOT_SUPPORTED 50
+#define ERROR_FILE_EXISTS 80
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_CALL_NOT_IMPLEMENTED 120
+#define ERROR_SEM_TIMEOUT 121
+#define ERROR_INSUFFICIENT_BUFFER 122
+#define ERROR_INVALID_NAME 123
+#define ERROR_ALREADY_EXISTS 183
+#define ERROR_PIPE_BUSY 231
+#define ERROR_PIPE_NOT_CONNECTED 233
+#define ERROR_MORE_DATA 234
+#define WAIT_TIMEOUT 258
+#define ERROR_DIRECTORY 267
+#define ERROR_INVALID_ADDRESS 487
+#define ERROR_PIPE_CONNECTED 535
+#define ERROR_OPERATION_ABORTED 995
+#define ERROR_IO_INCOMPLETE 996
+#define ERROR_IO_PENDING 997
+#define ERROR_NOT_FOUND 1168
+#define ERROR_NOT_ALL_ASSIGNED 1300
+#define ERROR_NO_SUCH_PRIVILEGE 1313
+#define ERROR_PRIVILEGE_NOT_HELD 1314
+#define ERROR_NO_SYSTEM_RESOURCES 1450
+#define ERROR_TIMEOUT 1460
+
+#define WAIT_OBJECT_0 0u
+#define WAIT_ABANDONED 0x80u
+#define WAIT_FAILED 0xFFFFFFFFu
+
+#define CREATE_EVENT_MANUAL_RESET 0x1
+#define CREATE_EVENT_INITIAL_SET 0x2
+#define EVENT_ALL_ACCESS 0x1F0003
+#define CREATE_WAITABLE_TIMER_MANUAL_RESET 0x1
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x2
+#define TIMER_ALL_ACCESS 0x1F0003
+
+#define GENERIC_READ 0x80000000u
+#define GENERIC_WRITE 0x40000000u
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define FILE_LIST_DIRECTORY 0x1
+#define FILE_ATTRIBUTE_READONLY 0x1
+#define FILE_ATTRIBUTE_HIDDEN 0x2
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x400
+#define FILE_FLAG_OVERLAPPED 0x40000000u
+#define FILE_FLAG_BACKUP_SEMANTICS 0x02000000u
+#define FILE_FLAG_OPEN_REPARSE_POINT 0x00200000u
+#define FILE_FLAG_FIRST_PIPE_INSTANCE 0x00080000u
+#define FILE_SKIP_COMPLETION_PORT_ON_SUCCESS 0x1
+#define FILE_SKIP_SET_EVENT_ON_HANDLE 0x2
+
+#define PIPE_ACCESS_INBOUND 0x1
+#define PIPE_ACCESS_OUTBOUND 0x2
+#define PIPE_ACCESS_DUPLEX 0x3
+#define PIPE_TYPE_BYTE 0x0
+#define PIPE_TYPE_MESSAGE 0x4
+#define PIPE_READMODE_BYTE 0x0
+#define PIPE_READMODE_MESSAGE 0x2
+#define PIPE_WAIT 0x0
+#define PIPE_NOWAIT 0x1
+#define PIPE_ACCEPT_REMOTE_CLIENTS 0x0
+#define PIPE_REJECT_REMOTE_CLIENTS 0x8
+#define PIPE_UNLIMITED_INSTANCES 255
+
+#define PAGE_NOACCESS 0x01
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define FILE_MAP_COPY 0x1
+#define FILE_MAP_WRITE 0x2
+#define FILE_MAP_READ 0x4
+#define FILE_MAP_ALL_ACCESS 0xF001F
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_DECOMMIT 0x4000
+#define MEM_RELEASE 0x8000
+#define MEM_FREE 0x10000
+#define MEM_PRIVATE 0x20000
+#define MEM_MAPPED 0x40000
+#define MEM_LARGE_PAGES 0x20000000
+#define NUMA_NO_PREFERRED_NODE 0xFFFFFFFFu
+
+#define TOKEN_QUERY 0x8
+#define TOKEN_ADJUST_PRIVILEGES 0x20
+#define SE_PRIVILEGE_ENABLED 0x2
+#define SE_LOCK_MEMORY_NAME TEXT("SeLockMemoryPrivilege")
+
+#define FORMAT_MESSAGE_IGNORE_INSERTS 0x200
+#define FORMAT_MESSAGE_FROM_SYSTEM 0x1000
+#define FORMAT_MESSAGE_MAX_WIDTH_MASK 0xFF
+
+typedef union _LARGE_INTEGER {
+	struct {
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	struct {
+		DWORD LowPart;
+		LONG HighPart;
+	} u;
+	LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef struct _FILETIME {
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME, *PFILETIME, *LPFILETIME;
+
+typedef struct _OVERLAPPED {
+	ULONG_PTR Internal;
+	ULONG_PTR InternalHigh;
+	union {
+		struct {
+			DWORD Offset;
+			DWORD OffsetHigh;
+		};
+		PVOID Pointer;
+	};
+	HANDLE hEvent;
+} OVERLAPPED, *LPOVERLAPPED;
+
+typedef struct _SECURITY_ATTRIBUTES {
+	DWORD nLength;
+	LPVOID lpSecurityDescriptor;
+	BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+typedef struct _MEMORY_BASIC_INFORMATION {
+	PVOID BaseAddress;
+	PVOID AllocationBase;
+	DWORD AllocationProtect;
+	SIZE_T RegionSize;
+	DWORD State;
+	DWORD Protect;
+	DWORD Type;
+} MEMORY_BASIC_INFORMATION, *PMEMORY_BASIC_INFORMATION;
+
+typedef struct _SYSTEM_INFO {
+	union {
+		DWORD dwOemId;
+		struct {
+			WORD wProcessorArchitecture;
+			WORD wReserved;
+		};
+	};
+	DWORD dwPageSize;
+	LPVOID lpMinimumApplicationAddress;
+	LPVOID lpMaximumApplicationAddress;
+	DWORD_PTR dwActiveProcessorMask;
+	DWORD dwNumberOfProcessors;
+	DWORD dwProcessorType;
+	DWORD dwAllocationGranularity;
+	WORD wProcessorLevel;
+	WORD wProcessorRevision;
+} SYSTEM_INFO, *LPSYSTEM_INFO;
+
+typedef struct _LUID {
+	DWORD LowPart;
+	LONG HighPart;
+} LUID, *PLUID;
+
+typedef struct _LUID_AND_ATTRIBUTES {
+	LUID Luid;
+	DWORD Attributes;
+} LUID_AND_ATTRIBUTES;
+
+typedef struct _TOKEN_PRIVILEGES {
+	DWORD PrivilegeCount;
+	LUID_AND_ATTRIBUTES Privileges[1];
+} TOKEN_PRIVILEGES, *PTOKEN_PRIVILEGES;
+
+typedef struct _GUID {
+	DWORD Data1;
+	WORD Data2;
+	WORD Data3;
+	BYTE Data4[8];
+} GUID;
+
+typedef struct _TP_CALLBACK_INSTANCE* PTP_CALLBACK_INSTANCE;
+typedef struct _TP_CALLBACK_ENVIRON* PTP_CALLBACK_ENVIRON;
+typedef struct _TP_WAIT* PTP_WAIT;
+typedef DWORD TP_WAIT_RESULT;
+typedef VOID (CALLBACK* PTP_WAIT_CALLBACK)(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WAIT wait, TP_WAIT_RESULT result);
+
+typedef VOID (CALLBACK* PTIMERAPCROUTINE)(LPVOID arg, DWORD low, DWORD high);
+
+typedef struct _BY_HANDLE_FILE_INFORMATION {
+	DWORD dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	DWORD dwVolumeSerialNumber;
+	DWORD nFileSizeHigh;
+	DWORD nFileSizeLow;
+	DWORD nNumberOfLinks;
+	DWORD nFileIndexHigh;
+	DWORD nFileIndexLow;
+} BY_HANDLE_FILE_INFORMATION, *LPBY_HANDLE_FILE_INFORMATION;
+
+typedef enum _FILE_INFO_BY_HANDLE_CLASS {
+	FileBasicInfo = 0,
+	FileStandardInfo = 1,
+	FileNameInfo = 2,
+	FileRenameInfo = 3,
+	FileDispositionInfo = 4,
+	FileAllocationInfo = 5,
+	FileEndOfFileInfo = 6,
+	FileStreamInfo = 7,
+	FileCompressionInfo = 8,
+	FileAttributeTagInfo = 9,
+	FileIdBothDirectoryInfo = 10,
+	FileIdBothDirectoryRestartInfo = 11,
+	FileIoPriorityHintInfo = 12,
+	FileRemoteProtocolInfo = 13,
+	FileFullDirectoryInfo = 14,
+	FileFullDirectoryRestartInfo = 15,
+	FileStorageInfo = 16,
+	FileAlignmentInfo = 17,
+	FileIdInfo = 18,
+	FileIdExtdDirectoryInfo = 19,
+	FileIdExtdDirectoryRestartInfo = 20,
+} FILE_INFO_BY_HANDLE_CLASS;
+
+typedef struct _FILE_BASIC_INFO {
+	LARGE_INTEGER CreationTime;
+	LARGE_INTEGER LastAccessTime;
+	LARGE_INTEGER LastWriteTime;
+	LARGE_INTEGER ChangeTime;
+	DWORD FileAttributes;
+} FILE_BASIC_INFO;
+
+typedef struct _FILE_STANDARD_INFO {
+	LARGE_INTEGER AllocationSize;
+	LARGE_INTEGER EndOfFile;
+	DWORD NumberOfLinks;
+	BOOLEAN DeletePending;
+	BOOLEAN Directory;
+} FILE_STANDARD_INFO;
+
+typedef struct _FILE_ID_128 {
+	BYTE Identifier[16];
+} FILE_ID_128;
+
+typedef struct _FILE_ID_INFO {
+	ULONGLONG VolumeSerialNumber;
+	FILE_ID_128 FileId;
+} FILE_ID_INFO;
+
+typedef struct _FILE_ALLOCATION_INFO {
+	LARGE_INTEGER AllocationSize;
+} FILE_ALLOCATION_INFO;
+
+typedef struct _FILE_END_OF_FILE_INFO {
+	LARGE_INTEGER EndOfFile;
+} FILE_END_OF_FILE_INFO;
+
+typedef struct _FILE_DISPOSITION_INFO {
+	BOOLEAN DeleteFile;
+} FILE_DISPOSITION_INFO;
+
+typedef struct _FILE_ID_BOTH_DIR_INFO {
+	DWORD NextEntryOffset;
+	DWORD FileIndex;
+	LARGE_INTEGER CreationTime;
+	LARGE_INTEGER LastAccessTime;
+	LARGE_INTEGER LastWriteTime;
+	LARGE_INTEGER ChangeTime;
+	LARGE_INTEGER EndOfFile;
+	LARGE_INTEGER AllocationSize;
+	DWORD FileAttributes;
+	DWORD FileNameLength;
+	DWORD EaSize;
+	CCHAR ShortNameLength;
+	WCHAR ShortName[12];
+	LARGE_INTEGER FileId;
+	WCHAR FileName[1];
+} FILE_ID_BOTH_DIR_INFO, *PFILE_ID_BOTH_DIR_INFO;
+
+inline thread_local DWORD standin_last_error = ERROR_SUCCESS;
+
+inline DWORD GetLastError() noexcept {
+	return standin_last_error;
+}
+
+inline void SetLastError(DWORD error) noexcept {
+	standin_last_error = error;
+}
+
+namespace standin {
+
+inline DWORD FromErrno(int error) noexcept {
+	switch (error) {
+	case 0: return ERROR_SUCCESS;
+	case ENOENT: return ERROR_FILE_NOT_FOUND;
+	case ENOTDIR: return ERROR_DIRECTORY;
+	case EACCES: case EPERM: return ERROR_ACCESS_DENIED;
+	case EBADF: return ERROR_INVALID_HANDLE;
+	case ENOMEM: return ERROR_NOT_ENOUGH_MEMORY;
+	case EEXIST: return ERROR_ALREADY_EXISTS;
+	case EINVAL: return ERROR_INVALID_PARAMETER;
+	case ENOSYS: case EOPNOTSUPP: return ERROR_NOT_SUPPORTED;
+	default: return ERROR_GEN_FAILURE;
+	}
+}
+
+// Sets the last error from errno and returns result
+template <typename T>
+T Fail(T result, int error = errno) noexcept {
+	SetLastError(FromErrno(error));
+	return result;
+}
+
+template <typename T>
+T FailWith(T result, DWORD error) noexcept {
+	SetLastError(error);
+	return result;
+}
+
+inline ULONGLONG Milliseconds() noexcept {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ULONGLONG(now.tv_sec) * 1000 + ULONGLONG(now.tv_nsec) / 1000000;
+}
+
+inline SIZE_T PageSize() noexcept {
+	static const SIZE_T size = SIZE_T(sysconf(_SC_PAGESIZE));
+	return size;
+}
+
+inline SIZE_T RoundUp(SIZE_T value, SIZE_T multiple) noexcept {
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+// Sleeps while *word == expected, for at most timeout milliseconds. The
+// word may live in shared memory, so the wait is not process-private.
+inline void FutexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected, DWORD timeout) noexcept {
+	timespec ts, *pts = nullptr;
+	if (timeout != INFINITE) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = long(timeout % 1000) * 1000000;
+		pts = &ts;
+	}
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, pts, nullptr, 0);
+}
+
+inline void FutexWake(std::atomic<std::uint32_t>& word, int count) noexcept {
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+// Kernel object behind a HANDLE; CloseHandle drops a reference
+struct Object {
+	std::atomic<int> references = 1;
+	virtual ~Object() = default;
+	virtual DWORD Wait(DWORD) {
+		return FailWith(WAIT_FAILED, ERROR_INVALID_HANDLE);
+	}
+};
+
+inline HANDLE AddRef(Object* object) noexcept {
+	object->references.fetch_add(1, std::memory_order_relaxed);
+	return object;
+}
+
+inline void Release(Object* object) noexcept {
+	if (object->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete object;
+	}
+}
+
+// Returns the object behind handle if it is a T, else sets
+// ERROR_INVALID_HANDLE and returns nullptr
+template <typename T>
+T* Get(HANDLE handle) noexcept {
+	T* object = nullptr;
+	if (handle != nullptr && handle != INVALID_HANDLE_VALUE) {
+		object = dynamic_cast<T*>(static_cast<Object*>(handle));
+	}
+	if (!object) {
+		SetLastError(ERROR_INVALID_HANDLE);
+	}
+	return object;
+}
+
+// Windows object names map to shm names; every kind of object gets its own
+// namespace, which is stricter than Windows but enough for the tests
+inline std::string SharedName(const char* kind, LPCSTR name) {
+	std::string result = "/swal-standin.";
+	result += kind;
+	result += '.';
+	for (; *name; ++name) {
+		result += (*name == '/' || *name == '\\') ? '_' : *name;
+	}
+	return result;
+}
+
+// Opens the shared memory object name, creating it with size bytes if it
+// does not exist. created tells which happened; an opener waits for the
+// creator to size the object. Returns -1 with the last error set.
+inline int OpenShared(const std::string& name, off_t size, bool create, bool& created) noexcept {
+	created = false;
+	int fd = -1;
+	if (create) {
+		fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0) {
+			if (ftruncate(fd, size) != 0) {
+				auto error = errno;
+				close(fd);
+				shm_unlink(name.c_str());
+				return Fail(-1, error);
+			}
+			created = true;
+			return fd;
+		}
+		if (errno != EEXIST) {
+			return Fail(-1);
+		}
+	}
+	fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0) {
+		return Fail(-1);
+	}
+	for (int i = 0;; ++i) {
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			auto error = errno;
+			close(fd);
+			return Fail(-1, error);
+		}
+		if (info.st_size != 0) {
+			break;
+		}
+		if (i == 1000) {
+			close(fd);
+			return FailWith(-1, ERROR_TIMEOUT);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return fd;
+}
+
+struct EventState {
+	std::atomic<std::uint32_t> signaled;
+	std::atomic<std::uint32_t> ready;
+	std::uint32_t manualReset;
+};
+
+struct Event : Object {
+	EventState* state = nullptr;
+	std::string name;
+	bool owner = false;
+	~Event() override {
+		if (name.empty()) {
+			delete state;
+			return;
+		}
+		munmap(state, sizeof(EventState));
+		if (owner) {
+			shm_unlink(name.c_str());
+		}
+	}
+	DWORD Wait(DWORD timeout) override {
+		auto deadline = Milliseconds() + timeout;
+		for (;;) {
+			if (state->manualReset) {
+				if (state->signaled.load(std::memory_order_acquire)) {
+					return WAIT_OBJECT_0;
+				}
+			} else {
+				std::uint32_t expected = 1;
+				if (state->signaled.compare_exchange_strong(expected, 0, std::memory_order_acquire)) {
+					return WAIT_OBJECT_0;
+				}
+			}
+			DWORD wait = INFINITE;
+			if (timeout != INFINITE) {
+				auto now = Milliseconds();
+				if (now >= deadline) {
+					return WAIT_TIMEOUT;
+				}
+				wait = DWORD(deadline - now);
+			}
+			FutexWait(state->signaled, 0, wait);
+		}
+	}
+	void Set() noexcept {
+		state->signaled.store(1, std::memory_order_release);
+		FutexWake(state->signaled, state->manualReset ? INT_MAX : 1);
+	}
+};
+
+inline HANDLE CreateEvent(bool manualReset, bool initialState, LPCSTR name) noexcept {
+	auto event = new Event;
+	if (!name) {
+		event->state = new EventState{ { initialState }, { 1 }, manualReset };
+		return FailWith(HANDLE(event), ERROR_SUCCESS);
+	}
+	event->name = SharedName("event", name);
+	bool created;
+	int fd = OpenShared(event->name, sizeof(EventState), true, created);
+	if (fd < 0) {
+		event->name.clear();
+		delete event;
+		return nullptr;
+	}
+	auto address = mmap(nullptr, sizeof(EventState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED) {
+		auto error = errno;
+		if (created) {
+			shm_unlink(event->name.c_str());
+		}
+		event->name.clear();
+		delete event;
+		return Fail(HANDLE(nullptr), error);
+	}
+	event->state = static_cast<EventState*>(address);
+	event->owner = created;
+	if (created) {
+		event->state->manualReset = manualReset;
+		event->state->signaled.store(initialState, std::memory_order_relaxed);
+		event->state->ready.store(1, std::memory_order_release);
+		return FailWith(HANDLE(event), ERROR_SUCCESS);
+	}
+	while (!event->state->ready.load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+	return FailWith(HANDLE(event), ERROR_ALREADY_EXISTS);
+}
+
+// Backing object of a file mapping; only pagefile-backed mappings exist
+struct Mapping : Object {
+	int fd = -1;
+	std::string name;
+	bool owner = false;
+	~Mapping() override {
+		close(fd);
+		if (owner) {
+			shm_unlink(name.c_str());
+		}
+	}
+};
+
+// Address ranges handed out by MapViewOfFile and VirtualAlloc, for
+// VirtualQuery and for releasing them
+struct Region {
+	SIZE_T size;
+	DWORD type;
+	// per page for MEM_PRIVATE; views are always committed
+	std::vector<bool> committed;
+};
+
+struct Regions {
+	std::mutex mutex;
+	std::map<std::uintptr_t, Region> regions;
+	static Regions& Instance() {
+		static Regions instance;
+		return instance;
+	}
+};
+
+}
+
+inline BOOL CloseHandle(HANDLE handle) noexcept {
+	auto object = standin::Get<standin::Object>(handle);
+	if (!object) {
+		return FALSE;
+	}
+	standin::Release(object);
+	return TRUE;
+}
+
+inline HANDLE CreateEvent(LPSECURITY_ATTRIBUTES, BOOL manualReset, BOOL initialState, LPCTSTR name) noexcept {
+	return standin::CreateEvent(manualReset, initialState, name);
+}
+
+inline HANDLE CreateEventEx(LPSECURITY_ATTRIBUTES, LPCTSTR name, DWORD flags, DWORD) noexcept {
+	return standin::CreateEvent(flags & CREATE_EVENT_MANUAL_RESET, flags & CREATE_EVENT_INITIAL_SET, name);
+}
+
+inline BOOL SetEvent(HANDLE handle) noexcept {
+	auto event = standin::Get<standin::Event>(handle);
+	if (!event) {
+		return FALSE;
+	}
+	event->Set();
+	return TRUE;
+}
+
+inline BOOL ResetEvent(HANDLE handle) noexcept {
+	auto event = standin::Get<standin::Event>(handle);
+	if (!event) {
+		return FALSE;
+	}
+	event->state->signaled.store(0, std::memory_order_relaxed);
+	return TRUE;
+}
+
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds) noexcept {
+	auto object = standin::Get<standin::Object>(handle);
+	if (!object) {
+		return WAIT_FAILED;
+	}
+	return object->Wait(milliseconds);
+}
+
+inline HANDLE CreateFileMapping(HANDLE file, LPSECURITY_ATTRIBUTES, DWORD protect, DWORD sizeHigh, DWORD sizeLow, LPCTSTR name) noexcept {
+	using namespace standin;
+	auto size = (ULONGLONG(sizeHigh) << 32) | sizeLow;
+	if (file != INVALID_HANDLE_VALUE) {
+		return FailWith(HANDLE(nullptr), ERROR_NOT_SUPPORTED);
+	}
+	if (size == 0 || (protect != PAGE_READWRITE && protect != PAGE_READONLY)) {
+		return FailWith(HANDLE(nullptr), ERROR_INVALID_PARAMETER);
+	}
+	auto mapping = new Mapping;
+	bool created = true;
+	if (name) {
+		mapping->name = SharedName("mapping", name);
+		mapping->fd = OpenShared(mapping->name, off_t(size), true, created);
+		mapping->owner = created;
+	} else {
+		mapping->fd = memfd_create("swal-standin.mapping", 0);
+		if (mapping->fd >= 0 && ftruncate(mapping->fd, off_t(size)) != 0) {
+			auto error = errno;
+			delete mapping;
+			return Fail(HANDLE(nullptr), error);
+		}
+	}
+	if (mapping->fd < 0) {
+		auto error = GetLastError();
+		mapping->name.clear();
+		delete mapping;
+		return FailWith(HANDLE(nullptr), error);
+	}
+	// like Windows, an existing mapping keeps its size
+	return FailWith(HANDLE(mapping), created ? ERROR_SUCCESS : ERROR_ALREADY_EXISTS);
+}
+
+inline HANDLE OpenFileMapping(DWORD, BOOL, LPCTSTR name) noexcept {
+	using namespace standin;
+	auto mapping = new Mapping;
+	mapping->name = SharedName("mapping", name);
+	bool created;
+	mapping->fd = OpenShared(mapping->name, 0, false, created);
+	if (mapping->fd < 0) {
+		auto error = GetLastError();
+		delete mapping;
+		return FailWith(HANDLE(nullptr), error);
+	}
+	return mapping;
+}
+
+inline LPVOID MapViewOfFile(HANDLE handle, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T size) noexcept {
+	using namespace standin;
+	auto mapping = Get<Mapping>(handle);
+	if (!mapping) {
+		return nullptr;
+	}
+	auto offset = (ULONGLONG(offsetHigh) << 32) | offsetLow;
+	struct stat info;
+	if (fstat(mapping->fd, &info) != 0) {
+		return Fail(LPVOID(nullptr));
+	}
+	if (offset % PageSize() != 0 || offset >= ULONGLONG(info.st_size) || size > ULONGLONG(info.st_size) - offset) {
+		return FailWith(LPVOID(nullptr), ERROR_INVALID_PARAMETER);
+	}
+	if (size == 0) {
+		size = SIZE_T(info.st_size - off_t(offset));
+	}
+	int protection = (access & FILE_MAP_WRITE) ? PROT_READ | PROT_WRITE : PROT_READ;
+	auto address = mmap(nullptr, size, protection, (access & FILE_MAP_COPY) ? MAP_PRIVATE : MAP_SHARED,
+		mapping->fd, off_t(offset));
+	if (address == MAP_FAILED) {
+		return Fail(LPVOID(nullptr));
+	}
+	auto& regions = Regions::Instance();
+	std::lock_guard lock(regions.mutex);
+	regions.regions[reinterpret_cast<std::uintptr_t>(address)] = { size, MEM_MAPPED };
+	return address;
+}
+
+inline BOOL UnmapViewOfFile(LPCVOID address) noexcept {
+	using namespace standin;
+	auto& regions = Regions::Instance();
+	std::lock_guard lock(regions.mutex);
+	auto region = regions.regions.find(reinterpret_cast<std::uintptr_t>(address));
+	if (region == regions.regions.end() || region->second.type != MEM_MAPPED) {
+		return FailWith(FALSE, ERROR_INVALID_PARAMETER);
+	}
+	munmap(const_cast<void*>(address), region->second.size);
+	regions.regions.erase(region);
+	return TRUE;
+}
+
+inline SIZE_T VirtualQuery(LPCVOID address, PMEMORY_BASIC_INFORMATION info, SIZE_T length) noexcept {
+	using namespace standin;
+	if (length < sizeof(MEMORY_BASIC_INFORMATION)) {
+		return FailWith(SIZE_T(0), ERROR_INSUFFICIENT_BUFFER);
+	}
+	auto& regions = Regions::Instance();
+	std::lock_guard lock(regions.mutex);
+	auto at = reinterpret_cast<std::uintptr_t>(address);
+	auto page = at / PageSize() * PageSize();
+	auto next = regions.regions.upper_bound(at);
+	auto region = next;
+	if (region != regions.regions.begin()) {
+		--region;
+	}
+	if (region == next || at >= region->first + RoundUp(region->second.size, PageSize())) {
+		// only the pages up to the next region are known to be free
+		*info = {};
+		info->BaseAddress = reinterpret_cast<PVOID>(page);
+		info->RegionSize = next != regions.regions.end() ? next->first - page : PageSize();
+		info->State = MEM_FREE;
+		info->Protect = PAGE_NOACCESS;
+		return sizeof(MEMORY_BASIC_INFORMATION);
+	}
+	// the run of pages that share the state of the first one
+	auto& committed = region->second.committed;
+	auto pages = RoundUp(region->second.size, PageSize()) / PageSize();
+	auto first = (page - region->first) / PageSize();
+	auto last = first + 1;
+	bool state = committed.empty() || committed[first];
+	if (!committed.empty()) {
+		while (last < pages && committed[last] == state) {
+			++last;
+		}
+	} else {
+		last = pages;
+	}
+	info->BaseAddress = reinterpret_cast<PVOID>(page);
+	info->AllocationBase = reinterpret_cast<PVOID>(region->first);
+	info->AllocationProtect = PAGE_READWRITE;
+	info->RegionSize = (last - first) * PageSize();
+	info->State = state ? MEM_COMMIT : MEM_RESERVE;
+	info->Protect = state ? PAGE_READWRITE : 0;
+	info->Type = region->second.type;
+	return sizeof(MEMORY_BASIC_INFORMATION);
+}
+
+namespace standin {
+
+// Whether the account holds SeLockMemoryPrivilege; tests revoke it to take
+// the fallback path
+inline std::atomic<bool> lockMemoryGranted = true;
+inline std::atomic<bool> lockMemoryEnabled = false;
+
+// Stands in for a GetLargePageMinimum of 2 MiB, the usual huge page size
+constexpr SIZE_T LargePageSize = 2 * 1024 * 1024;
+
+struct Token : Object {};
+
+inline int Protection(DWORD protect) noexcept {
+	switch (protect) {
+	case PAGE_READWRITE: return PROT_READ | PROT_WRITE;
+	case PAGE_READONLY: return PROT_READ;
+	case PAGE_NOACCESS: return PROT_NONE;
+	default: return -1;
+	}
+}
+
+// Reserves address space with PROT_NONE and MAP_NORESERVE, so that only
+// committed pages count against memory; large pages come from hugetlbfs
+// and are committed up front, as on Windows
+inline LPVOID Reserve(SIZE_T size, DWORD type, int protection) noexcept {
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	bool commit = type & MEM_COMMIT;
+	if (type & MEM_LARGE_PAGES) {
+		if (!lockMemoryEnabled.load()) {
+			return FailWith(LPVOID(nullptr), ERROR_PRIVILEGE_NOT_HELD);
+		}
+		if (!commit || size % LargePageSize != 0) {
+			return FailWith(LPVOID(nullptr), ERROR_INVALID_PARAMETER);
+		}
+		flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+	}
+	size = RoundUp(size, PageSize());
+	auto address = mmap(nullptr, size, commit ? protection : PROT_NONE, flags, -1, 0);
+	if (address == MAP_FAILED) {
+		return FailWith(LPVOID(nullptr), (type & MEM_LARGE_PAGES) ? ERROR_NO_SYSTEM_RESOURCES : ERROR_NOT_ENOUGH_MEMORY);
+	}
+	auto& regions = Regions::Instance();
+	std::lock_guard lock(regions.mutex);
+	regions.regions[reinterpret_cast<std::uintptr_t>(address)] = { size, MEM_PRIVATE, std::vector<bool>(size / PageSize(), commit) };
+	return address;
+}
+
+// Widens [address, address + size) to whole pages and returns the reserved
+// region that contains them with the index of the first page, or nullptr
+// with the last error set
+inline Region* FindPages(std::uintptr_t& address, SIZE_T& size, std::size_t& first) noexcept {
+	auto& regions = Regions::Instance();
+	auto region = regions.regions.upper_bound(address);
+	if (region == regions.regions.begin()) {
+		return FailWith(nullptr, ERROR_INVALID_ADDRESS);
+	}
+	--region;
+	auto end = RoundUp(address + size, PageSize());
+	address = address / PageSize() * PageSize();
+	size = end - address;
+	if (region->second.type != MEM_PRIVATE || end > region->first + region->second.size) {
+		return FailWith(nullptr, ERROR_INVALID_ADDRESS);
+	}
+	first = (address - region->first) / PageSize();
+	return &region->second;
+}
+
+inline LPVOID Commit(LPVOID address, SIZE_T size, int protection) noexcept {
+	auto at = reinterpret_cast<std::uintptr_t>(address);
+	auto& regions = Regions::Instance();
+	std::lock_guard lock(regions.mutex);
+	std::size_t first;
+	auto region = FindPages(at, size, first);
+	if (!region) {
+		return nullptr;
+	}
+	if (mprotect(reinterpret_cast<void*>(at), size, protection) != 0) {
+		return Fail(LPVOID(nullptr));
+	}
+	std::fill_n(region->committed.begin() + std::ptrdiff_t(first), size / PageSize(), true);
+	return reinterpret_cast<LPVOID>(at);
+}
+
+}
+
+inline LPVOID VirtualAlloc(LPVOID address, SIZE_T size, DWORD type, DWORD protect) noexcept {
+	using namespace standin;
+	auto protection = Protection(protect);
+	if (size == 0 || protection < 0 || !(type & (MEM_RESERVE | MEM_COMMIT))) {
+		return FailWith(LPVOID(nullptr), ERROR_INVALID_PARAMETER);
+	}
+	if (type & MEM_RESERVE) {
+		if (address) {
+			return FailWith(LPVOID(nullptr), ERROR_NOT_SUPPORTED);
+		}
+		return Reserve(size, type, protection);
+	}
+	return Commit(address, size, protection);
+}
+
+// The node preference is ignored; there is no libnuma dependency
+inline LPVOID VirtualAllocExNuma(HANDLE, LPVOID address, SIZE_T size, DWORD type, DWORD protect, DWORD) noexcept {
+	return VirtualAlloc(address, size, type, protect);
+}
+
+inline BOOL VirtualFree(LPVOID address, SIZE_T size, DWORD type) noexcept {
+	using namespace standin;
+	auto at = reinterpret_cast<std::uintptr_t>(address);
+	auto& regions = Regions::Instance();
+	std::lock_guard lock(regions.mutex);
+	if (type == MEM_RELEASE) {
+		auto region = regions.regions.find(at);
+		if (size != 0 || region == regions.regions.end() || region->second.type != MEM_PRIVATE) {
+			return FailWith(FALSE, ERROR_INVALID_PARAMETER);
+		}
+		munmap(address, region->second.size);
+		regions.regions.erase(region);
+		return TRUE;
+	}
+	if (type != MEM_DECOMMIT || size == 0) {
+		return FailWith(FALSE, ERROR_INVALID_PARAMETER);
+	}
+	std::size_t first;
+	auto region = FindPages(at, size, first);
+	if (!region) {
+		return FALSE;
+	}
+	// the pages are dropped, so they read back as zero once recommitted
+	if (madvise(reinterpret_cast<void*>(at), size, MADV_DONTNEED) != 0 ||
+		mprotect(reinterpret_cast<void*>(at), size, PROT_NONE) != 0)
+	{
+		return Fail(FALSE);
+	}
+	std::fill_n(region->committed.begin() + std::ptrdiff_t(first), size / PageSize(), false);
+	return TRUE;
+}
+
+inline VOID GetSystemInfo(LPSYSTEM_INFO info) noexcept {
+	*info = {};
+	info->dwPageSize = DWORD(standin::PageSize());
+	info->dwAllocationGranularity = DWORD(standin::PageSize());
+	info->dwNumberOfProcessors = std::max(1u, std::thread::hardware_concurrency());
+}
+
+inline SIZE_T GetLargePageMinimum() noexcept {
+	return standin::LargePageSize;
+}
+
+inline HANDLE GetCurrentProcess() noexcept {
+	return INVALID_HANDLE_VALUE;
+}
+
+inline BOOL OpenProcessToken(HANDLE, DWORD, PHANDLE token) noexcept {
+	*token = new standin::Token;
+	return TRUE;
+}
+
+inline BOOL LookupPrivilegeValue(LPCTSTR, LPCTSTR name, PLUID luid) noexcept {
+	if (std::strcmp(name, SE_LOCK_MEMORY_NAME) != 0) {
+		return standin::FailWith(FALSE, ERROR_NO_SUCH_PRIVILEGE);
+	}
+	*luid = { 4, 0 };
+	return TRUE;
+}
+
+// Only SeLockMemoryPrivilege is known; like Windows this succeeds with
+// ERROR_NOT_ALL_ASSIGNED when the account does not hold it
+inline BOOL AdjustTokenPrivileges(HANDLE token, BOOL, PTOKEN_PRIVILEGES privileges, DWORD, PTOKEN_PRIVILEGES, LPDWORD) noexcept {
+	using namespace standin;
+	if (!Get<Token>(token)) {
+		return FALSE;
+	}
+	DWORD error = ERROR_SUCCESS;
+	for (DWORD i = 0; i < privileges->PrivilegeCount; ++i) {
+		auto& privilege = privileges->Privileges[i];
+		if (privilege.Luid.LowPart != 4 || privilege.Luid.HighPart != 0) {
+			continue;
+		}
+		bool enable = privilege.Attributes & SE_PRIVILEGE_ENABLED;
+		if (enable && !lockMemoryGranted.load()) {
+			error = ERROR_NOT_ALL_ASSIGNED;
+			continue;
+		}
+		lockMemoryEnabled.store(enable);
+	}
+	return FailWith(TRUE, error);
+}
+
+inline VOID Sleep(DWORD milliseconds) noexcept {
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+inline ULONGLONG GetTickCount64() noexcept {
+	return standin::Milliseconds();
+}
+
+inline VOID YieldProcessor() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+inline DWORD FormatMessage(DWORD, LPCVOID, DWORD messageId, DWORD, LPTSTR buffer, DWORD size, void*) noexcept {
+	auto length = std::snprintf(buffer, size, "Win32 error %u", messageId);
+	return length < 0 ? 0 : DWORD(std::min<std::size_t>(std::size_t(length), size - 1));
+}
+
+// Only UTF-8 is supported, and CP_ACP is treated as UTF-8
+inline int WideCharToMultiByte(UINT, DWORD, LPCWSTR source, int sourceLength, LPSTR target, int targetLength,
+	LPCSTR, BOOL* usedDefaultChar) noexcept
+{
+	if (sourceLength < 0) {
+		sourceLength = int(std::wcslen(source)) + 1;
+	}
+	if (usedDefaultChar) {
+		*usedDefaultChar = FALSE;
+	}
+	int length = 0;
+	for (int i = 0; i < sourceLength; ++i) {
+		auto c = std::uint32_t(source[i]);
+		char bytes[4];
+		int count;
+		if (c < 0x80) {
+			bytes[0] = char(c);
+			count = 1;
+		} else if (c < 0x800) {
+			bytes[0] = char(0xC0 | (c >> 6));
+			bytes[1] = char(0x80 | (c & 0x3F));
+			count = 2;
+		} else if (c < 0x10000) {
+			bytes[0] = char(0xE0 | (c >> 12));
+			bytes[1] = char(0x80 | ((c >> 6) & 0x3F));
+			bytes[2] = char(0x80 | (c & 0x3F));
+			count = 3;
+		} else {
+			bytes[0] = char(0xF0 | (c >> 18));
+			bytes[1] = char(0x80 | ((c >> 12) & 0x3F));
+			bytes[2] = char(0x80 | ((c >> 6) & 0x3F));
+			bytes[3] = char(0x80 | (c & 0x3F));
+			count = 4;
+		}
+		if (targetLength != 0) {
+			if (length + count > targetLength) {
+				return standin::FailWith(0, ERROR_INSUFFICIENT_BUFFER);
+			}
+			std::memcpy(target + length, bytes, std::size_t(count));
+		}
+		length += count;
+	}
+	return length;
+}
+
+inline int MultiByteToWideChar(UINT, DWORD, LPCSTR source, int sourceLength, LPWSTR target, int targetLength) noexcept {
+	if (sourceLength < 0) {
+		sourceLength = int(std::strlen(source)) + 1;
+	}
+	int length = 0;
+	for (int i = 0; i < sourceLength;) {
+		auto c = std::uint32_t(static_cast<unsigned char>(source[i]));
+		int count = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+		if (count > 1) {
+			c &= 0x3F >> (count - 1);
+		}
+		if (i + count > sourceLength) {
+			return standin::FailWith(0, ERROR_INVALID_DATA);
+		}
+		for (int j = 1; j < count; ++j) {
+			c = (c << 6) | (static_cast<unsigned char>(source[i + j]) & 0x3F);
+		}
+		i += count;
+		if (targetLength != 0) {
+			if (length == targetLength) {
+				return standin::FailWith(0, ERROR_INSUFFICIENT_BUFFER);
+			}
+			target[length] = WCHAR(c);
+		}
+		++length;
+	}
+	return length;
+}
+
+namespace standin {
+
+// Record returned by the getdents64 system call
+struct Dirent64 {
+	std::uint64_t ino;
+	std::int64_t off;
+	unsigned short reclen;
+	unsigned char type;
+	char name[1];
+};
+
+// Open file or directory. A directory keeps the raw getdents64 output that
+// has not been returned yet, so that an entry that did not fit into the
+// caller's buffer comes first in the next call.
+struct File : Object {
+	int fd = -1;
+	std::vector<char> entries;
+	std::size_t next = 0;
+	std::size_t end = 0;
+	~File() override {
+		close(fd);
+	}
+};
+
+inline LARGE_INTEGER ToFileTime(const timespec& time) noexcept {
+	// 100 ns intervals since 1601-01-01
+	LARGE_INTEGER result;
+	result.QuadPart = LONGLONG(time.tv_sec) * 10000000 + time.tv_nsec / 100 + 116444736000000000;
+	return result;
+}
+
+// Fills buffer with FILE_ID_BOTH_DIR_INFO records from getdents64 and
+// fstatat; returns the number of records written, or -1 with the last
+// error set
+inline int QueryDirectory(File& dir, bool restart, BYTE* buffer, DWORD size) noexcept {
+	if (restart) {
+		if (lseek(dir.fd, 0, SEEK_SET) != 0) {
+			return Fail(-1);
+		}
+		dir.next = dir.end = 0;
+	}
+	if (dir.entries.empty()) {
+		dir.entries.resize(64 * 1024);
+	}
+	constexpr auto header = offsetof(FILE_ID_BOTH_DIR_INFO, FileName);
+	int count = 0;
+	FILE_ID_BOTH_DIR_INFO* last = nullptr;
+	DWORD used = 0;
+	for (;;) {
+		if (dir.next == dir.end) {
+			auto read = syscall(SYS_getdents64, dir.fd, dir.entries.data(), dir.entries.size());
+			if (read < 0) {
+				return Fail(-1);
+			}
+			dir.next = 0;
+			dir.end = std::size_t(read);
+			if (read == 0) {
+				break;
+			}
+		}
+		auto& entry = *reinterpret_cast<const Dirent64*>(dir.entries.data() + dir.next);
+		WCHAR name[NAME_MAX + 1];
+		int length = MultiByteToWideChar(CP_UTF8, 0, entry.name, int(std::strlen(entry.name)), name, NAME_MAX + 1);
+		auto record = DWORD(RoundUp(header + std::size_t(length) * sizeof(WCHAR), 8));
+		if (used + record > size) {
+			break;
+		}
+		struct stat info;
+		if (fstatat(dir.fd, entry.name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+			if (errno == ENOENT) {
+				// deleted since it was read
+				dir.next += entry.reclen;
+				continue;
+			}
+			return Fail(-1);
+		}
+		auto out = reinterpret_cast<FILE_ID_BOTH_DIR_INFO*>(buffer + used);
+		std::memset(out, 0, header);
+		out->CreationTime = ToFileTime(info.st_ctim);
+		out->LastAccessTime = ToFileTime(info.st_atim);
+		out->LastWriteTime = ToFileTime(info.st_mtim);
+		out->ChangeTime = ToFileTime(info.st_ctim);
+		out->EndOfFile.QuadPart = info.st_size;
+		out->AllocationSize.QuadPart = LONGLONG(info.st_blocks) * 512;
+		if (S_ISDIR(info.st_mode)) {
+			out->FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		} else if (S_ISLNK(info.st_mode)) {
+			// like a Windows symbolic link, flagged as a directory if the
+			// target is one
+			struct stat target;
+			out->FileAttributes = FILE_ATTRIBUTE_REPARSE_POINT;
+			if (fstatat(dir.fd, entry.name, &target, 0) == 0 && S_ISDIR(target.st_mode)) {
+				out->FileAttributes |= FILE_ATTRIBUTE_DIRECTORY;
+			}
+		} else {
+			out->FileAttributes = FILE_ATTRIBUTE_NORMAL;
+		}
+		out->FileId.QuadPart = LONGLONG(info.st_ino);
+		out->FileNameLength = DWORD(length) * sizeof(WCHAR);
+		std::memcpy(out->FileName, name, out->FileNameLength);
+		if (last) {
+			last->NextEntryOffset = DWORD(reinterpret_cast<BYTE*>(out) - reinterpret_cast<BYTE*>(last));
+		}
+		last = out;
+		used += record;
+		++count;
+		dir.next += entry.reclen;
+	}
+	if (count == 0) {
+		return FailWith(-1, dir.end == 0 ? ERROR_NO_MORE_FILES : ERROR_MORE_DATA);
+	}
+	return count;
+}
+
+}
+
+// Opens existing files and directories only
+inline HANDLE CreateFileW(LPCWSTR name, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD createMode, DWORD, HANDLE) noexcept {
+	using namespace standin;
+	if (createMode != OPEN_EXISTING) {
+		return FailWith(INVALID_HANDLE_VALUE, ERROR_NOT_SUPPORTED);
+	}
+	std::string path(std::size_t(WideCharToMultiByte(CP_UTF8, 0, name, -1, nullptr, 0, nullptr, nullptr)), '\0');
+	WideCharToMultiByte(CP_UTF8, 0, name, -1, path.data(), int(path.size()), nullptr, nullptr);
+	std::replace(path.begin(), path.end(), '\\', '/');
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return Fail(INVALID_HANDLE_VALUE);
+	}
+	auto file = new File;
+	file->fd = fd;
+	return FailWith(HANDLE(file), ERROR_SUCCESS);
+}
+
+inline BOOL GetFileInformationByHandleEx(HANDLE handle, FILE_INFO_BY_HANDLE_CLASS infoClass, LPVOID info, DWORD size) noexcept {
+	using namespace standin;
+	auto file = Get<File>(handle);
+	if (!file) {
+		return FALSE;
+	}
+	if (infoClass != FileIdBothDirectoryInfo && infoClass != FileIdBothDirectoryRestartInfo) {
+		return FailWith(FALSE, ERROR_NOT_SUPPORTED);
+	}
+	return QueryDirectory(*file, infoClass == FileIdBothDirectoryRestartInfo, static_cast<BYTE*>(info), size) > 0;
+}
+
+namespace standin {
+
+struct Packet {
+	DWORD bytes;
+	ULONG_PTR key;
+	LPOVERLAPPED ovl;
+	DWORD error;
+};
+
+struct Port : Object {
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<Packet> packets;
+	void Post(const Packet& packet) {
+		{
+			std::lock_guard lock(mutex);
+			packets.push_back(packet);
+		}
+		ready.notify_one();
+	}
+};
+
+// OVERLAPPED::Internal holds this until the operation completes, and the
+// Win32 error code after that
+constexpr ULONG_PTR Pending = ~ULONG_PTR(0);
+
+inline std::atomic_ref<ULONG_PTR> Status(OVERLAPPED& ovl) noexcept {
+	return std::atomic_ref(ovl.Internal);
+}
+
+// One non-blocking attempt at an operation: returns false if it would
+// block, else sets error and bytes
+using Attempt = std::function<bool(DWORD& error, DWORD& bytes)>;
+
+struct Operation {
+	LPOVERLAPPED ovl;
+	int fd;
+	short events;
+	Attempt attempt;
+	std::atomic<bool> cancelled = false;
+	int wake = eventfd(0, EFD_CLOEXEC);
+	~Operation() {
+		close(wake);
+	}
+	void Cancel() noexcept {
+		cancelled = true;
+		std::uint64_t one = 1;
+		[[maybe_unused]] auto written = write(wake, &one, sizeof(one));
+	}
+};
+
+// Descriptor that supports overlapped I/O. An operation that cannot finish
+// at once gets a thread of its own, which polls the descriptor until the
+// operation is done or cancelled and then completes it.
+struct IoObject : Object {
+	int fd = -1;
+	std::mutex mutex;
+	Port* port = nullptr;
+	ULONG_PTR key = 0;
+	DWORD modes = 0;
+	std::vector<Operation*> pending;
+	~IoObject() override {
+		close(fd);
+		if (port) {
+			Release(port);
+		}
+	}
+	void Complete(LPOVERLAPPED ovl, DWORD error, DWORD bytes, bool synchronous) noexcept {
+		// ovl may be reused as soon as its status is visible
+		auto event = reinterpret_cast<ULONG_PTR>(ovl->hEvent);
+		ovl->InternalHigh = bytes;
+		Status(*ovl).store(error, std::memory_order_release);
+		if (synchronous && (modes & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)) {
+			return;
+		}
+		if (event & ~ULONG_PTR(1)) {
+			SetEvent(reinterpret_cast<HANDLE>(event & ~ULONG_PTR(1)));
+		}
+		if (port && !(event & 1)) {
+			port->Post({ bytes, key, ovl, error });
+		}
+	}
+	// Returns the error of an inline completion, which is only queued if it
+	// succeeded, or ERROR_IO_PENDING. A pending operation waits for events on
+	// target, which defaults to the object's own descriptor.
+	DWORD Start(LPOVERLAPPED ovl, short events, Attempt attempt, LPDWORD transferred, int target = -1) {
+		Status(*ovl).store(Pending, std::memory_order_relaxed);
+		DWORD error = ERROR_SUCCESS, bytes = 0;
+		if (attempt(error, bytes)) {
+			if (transferred) {
+				*transferred = bytes;
+			}
+			if (error == ERROR_SUCCESS) {
+				Complete(ovl, error, bytes, true);
+			} else {
+				ovl->InternalHigh = bytes;
+				Status(*ovl).store(error, std::memory_order_release);
+			}
+			return error;
+		}
+		auto operation = new Operation{ ovl, target < 0 ? fd : target, events, std::move(attempt) };
+		{
+			std::lock_guard lock(mutex);
+			pending.push_back(operation);
+		}
+		AddRef(this);
+		std::thread([this, operation] { Run(operation); }).detach();
+		return ERROR_IO_PENDING;
+	}
+	// Cancels the operations on ovl, or all of them if it is nullptr
+	bool Cancel(LPOVERLAPPED ovl) noexcept {
+		std::lock_guard lock(mutex);
+		bool found = false;
+		for (auto operation : pending) {
+			if (!ovl || operation->ovl == ovl) {
+				operation->Cancel();
+				found = true;
+			}
+		}
+		return found;
+	}
+private:
+	void Run(Operation* operation) noexcept {
+		DWORD error = ERROR_SUCCESS, bytes = 0;
+		for (;;) {
+			pollfd fds[2] = { { operation->fd, operation->events, 0 }, { operation->wake, POLLIN, 0 } };
+			poll(fds, 2, -1);
+			if (operation->cancelled) {
+				error = ERROR_OPERATION_ABORTED;
+				break;
+			}
+			if (operation->attempt(error, bytes)) {
+				break;
+			}
+		}
+		{
+			std::lock_guard lock(mutex);
+			pending.erase(std::find(pending.begin(), pending.end(), operation));
+		}
+		Complete(operation->ovl, error, bytes, false);
+		delete operation;
+		Release(this);
+	}
+};
+
+}
+
+inline HANDLE CreateIoCompletionPort(HANDLE file, HANDLE existing, ULONG_PTR key, DWORD) noexcept {
+	using namespace standin;
+	Port* port;
+	if (existing) {
+		port = Get<Port>(existing);
+		if (!port) {
+			return nullptr;
+		}
+	} else {
+		port = new Port;
+	}
+	if (file == INVALID_HANDLE_VALUE) {
+		if (existing) {
+			return FailWith(HANDLE(nullptr), ERROR_INVALID_PARAMETER);
+		}
+		return FailWith(HANDLE(port), ERROR_SUCCESS);
+	}
+	auto object = Get<IoObject>(file);
+	if (!object) {
+		if (!existing) {
+			Release(port);
+		}
+		return nullptr;
+	}
+	std::lock_guard lock(object->mutex);
+	if (object->port) {
+		if (!existing) {
+			Release(port);
+		}
+		return FailWith(HANDLE(nullptr), ERROR_INVALID_PARAMETER);
+	}
+	// the association keeps the port alive as long as the file
+	object->port = port;
+	object->key = key;
+	AddRef(port);
+	return FailWith(HANDLE(port), ERROR_SUCCESS);
+}
+
+inline BOOL GetQueuedCompletionStatus(HANDLE handle, LPDWORD transferred, PULONG_PTR key, LPOVERLAPPED* ovl, DWORD timeout) noexcept {
+	using namespace standin;
+	*ovl = nullptr;
+	auto port = Get<Port>(handle);
+	if (!port) {
+		return FALSE;
+	}
+	std::unique_lock lock(port->mutex);
+	auto ready = [port] { return !port->packets.empty(); };
+	if (timeout == INFINITE) {
+		port->ready.wait(lock, ready);
+	} else if (!port->ready.wait_for(lock, std::chrono::milliseconds(timeout), ready)) {
+		return FailWith(FALSE, WAIT_TIMEOUT);
+	}
+	auto packet = port->packets.front();
+	port->packets.pop_front();
+	*transferred = packet.bytes;
+	*key = packet.key;
+	*ovl = packet.ovl;
+	if (packet.error != ERROR_SUCCESS) {
+		return FailWith(FALSE, packet.error);
+	}
+	return TRUE;
+}
+
+inline BOOL PostQueuedCompletionStatus(HANDLE handle, DWORD transferred, ULONG_PTR key, LPOVERLAPPED ovl) noexcept {
+	auto port = standin::Get<standin::Port>(handle);
+	if (!port) {
+		return FALSE;
+	}
+	port->Post({ transferred, key, ovl, ERROR_SUCCESS });
+	return TRUE;
+}
+
+inline BOOL CancelIoEx(HANDLE handle, LPOVERLAPPED ovl) noexcept {
+	auto object = standin::Get<standin::IoObject>(handle);
+	if (!object) {
+		return FALSE;
+	}
+	return object->Cancel(ovl) ? TRUE : standin::FailWith(FALSE, ERROR_NOT_FOUND);
+}
+
+// Cancels the operations of every thread, not only those of the caller
+inline BOOL CancelIo(HANDLE handle) noexcept {
+	auto object = standin::Get<standin::IoObject>(handle);
+	if (!object) {
+		return FALSE;
+	}
+	object->Cancel(nullptr);
+	return TRUE;
+}
+
+inline BOOL SetFileCompletionNotificationModes(HANDLE handle, UCHAR flags) noexcept {
+	auto object = standin::Get<standin::IoObject>(handle);
+	if (!object) {
+		return FALSE;
+	}
+	std::lock_guard lock(object->mutex);
+	object->modes = flags;
+	return TRUE;
+}
+
+namespace standin {
+
+// Named pipe end on an AF_UNIX socket in the abstract namespace, a
+// SOCK_SEQPACKET one for message pipes. Each name has one instance, whose
+// listening socket stays open until the handle is closed; a client that
+// connects before the server listens is reported as ERROR_PIPE_CONNECTED.
+struct Pipe : IoObject {
+	int listener = -1;
+	~Pipe() override {
+		close(listener);
+	}
+};
+
+inline bool PipeAddress(LPCSTR name, sockaddr_un& address, socklen_t& length) noexcept {
+	constexpr char prefix[] = "\\\\.\\pipe\\";
+	auto size = std::strlen(name);
+	if (std::strncmp(name, prefix, sizeof(prefix) - 1) != 0 || size + 11 > sizeof(address.sun_path)) {
+		return false;
+	}
+	address = {};
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path + 1, "swal-pipe:", 10);
+	std::memcpy(address.sun_path + 11, name, size);
+	length = socklen_t(offsetof(sockaddr_un, sun_path) + 11 + size);
+	return true;
+}
+
+// Waits for a client on the server end; with ovl the wait is overlapped
+inline BOOL Listen(Pipe& pipe, LPOVERLAPPED ovl) noexcept {
+	{
+		std::lock_guard lock(pipe.mutex);
+		if (pipe.listener < 0) {
+			return FailWith(FALSE, ERROR_INVALID_FUNCTION);
+		}
+		if (pipe.fd >= 0) {
+			return FailWith(FALSE, ERROR_PIPE_CONNECTED);
+		}
+	}
+	bool first = true;
+	auto pipePtr = &pipe;
+	Attempt attempt = [pipePtr, first](DWORD& error, DWORD&) mutable {
+		int fd = accept4(pipePtr->listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		bool connectedBefore = std::exchange(first, false);
+		if (fd < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return false;
+			}
+			error = FromErrno(errno);
+			return true;
+		}
+		{
+			std::lock_guard lock(pipePtr->mutex);
+			pipePtr->fd = fd;
+		}
+		error = connectedBefore ? ERROR_PIPE_CONNECTED : ERROR_SUCCESS;
+		return true;
+	};
+	if (!ovl) {
+		DWORD error = ERROR_SUCCESS, bytes = 0;
+		while (!attempt(error, bytes)) {
+			pollfd fds[1] = { { pipe.listener, POLLIN, 0 } };
+			poll(fds, 1, -1);
+		}
+		return error == ERROR_SUCCESS ? TRUE : FailWith(FALSE, error);
+	}
+	auto error = pipe.Start(ovl, POLLIN, std::move(attempt), nullptr, pipe.listener);
+	return error == ERROR_SUCCESS ? TRUE : FailWith(FALSE, error);
+}
+
+}
+
+inline HANDLE CreateNamedPipe(LPCTSTR name, DWORD openMode, DWORD pipeMode, DWORD, DWORD, DWORD, DWORD, LPSECURITY_ATTRIBUTES) noexcept {
+	using namespace standin;
+	sockaddr_un address;
+	socklen_t length;
+	if (!PipeAddress(name, address, length)) {
+		return FailWith(INVALID_HANDLE_VALUE, ERROR_INVALID_NAME);
+	}
+	int type = (pipeMode & PIPE_TYPE_MESSAGE) ? SOCK_SEQPACKET : SOCK_STREAM;
+	int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return Fail(INVALID_HANDLE_VALUE);
+	}
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), length) != 0 || listen(fd, 1) != 0) {
+		auto error = errno;
+		close(fd);
+		if (error == EADDRINUSE) {
+			return FailWith(INVALID_HANDLE_VALUE, (openMode & FILE_FLAG_FIRST_PIPE_INSTANCE) ? ERROR_ACCESS_DENIED : ERROR_PIPE_BUSY);
+		}
+		return Fail(INVALID_HANDLE_VALUE, error);
+	}
+	auto pipe = new Pipe;
+	pipe->listener = fd;
+	return FailWith(HANDLE(pipe), ERROR_SUCCESS);
+}
+
+inline BOOL ConnectNamedPipe(HANDLE handle, LPOVERLAPPED ovl) noexcept {
+	auto pipe = standin::Get<standin::Pipe>(handle);
+	if (!pipe) {
+		return FALSE;
+	}
+	return standin::Listen(*pipe, ovl);
+}
+
+inline BOOL DisconnectNamedPipe(HANDLE handle) noexcept {
+	auto pipe = standin::Get<standin::Pipe>(handle);
+	if (!pipe) {
+		return FALSE;
+	}
+	pipe->Cancel(nullptr);
+	std::lock_guard lock(pipe->mutex);
+	close(std::exchange(pipe->fd, -1));
+	return TRUE;
+}
+
+// Opens the client end of a named pipe; other files are opened through
+// CreateFileW
+inline HANDLE CreateFile(LPCTSTR name, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD createMode, DWORD, HANDLE) noexcept {
+	using namespace standin;
+	sockaddr_un address;
+	socklen_t length;
+	if (!PipeAddress(name, address, length)) {
+		return FailWith(INVALID_HANDLE_VALUE, ERROR_NOT_SUPPORTED);
+	}
+	if (createMode != OPEN_EXISTING) {
+		return FailWith(INVALID_HANDLE_VALUE, ERROR_INVALID_PARAMETER);
+	}
+	for (int type : { SOCK_SEQPACKET, SOCK_STREAM }) {
+		int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+		if (fd < 0) {
+			return Fail(INVALID_HANDLE_VALUE);
+		}
+		if (connect(fd, reinterpret_cast<sockaddr*>(&address), length) == 0) {
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			auto pipe = new Pipe;
+			pipe->fd = fd;
+			return FailWith(HANDLE(pipe), ERROR_SUCCESS);
+		}
+		auto error = errno;
+		close(fd);
+		if (error != EPROTOTYPE) {
+			return FailWith(INVALID_HANDLE_VALUE, error == EAGAIN ? ERROR_PIPE_BUSY : ERROR_FILE_NOT_FOUND);
+		}
+	}
+	return FailWith(INVALID_HANDLE_VALUE, ERROR_FILE_NOT_FOUND);
+}
+
+// Declared for the swal headers, not implemented by the stand-in
+
+BOOL ReadFile(HANDLE file, LPVOID buffer, DWORD size, LPDWORD read, LPOVERLAPPED ovl);
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD size, LPDWORD written, LPOVERLAPPED ovl);
+BOOL GetOverlappedResult(HANDLE file, LPOVERLAPPED ovl, LPDWORD transferred, BOOL wait);
+BOOL SetFilePointerEx(HANDLE file, LARGE_INTEGER distance, PLARGE_INTEGER position, DWORD method);
+BOOL SetEndOfFile(HANDLE file);
+BOOL GetFileSizeEx(HANDLE file, PLARGE_INTEGER size);
+BOOL GetFileInformationByHandle(HANDLE file, LPBY_HANDLE_FILE_INFORMATION info);
+BOOL SetFileInformationByHandle(HANDLE file, FILE_INFO_BY_HANDLE_CLASS infoClass, LPVOID info, DWORD size);
+BOOL SetNamedPipeHandleState(HANDLE pipe, LPDWORD mode, LPDWORD maxCollection, LPDWORD collectTimeout);
+BOOL WaitNamedPipe(LPCTSTR name, DWORD timeout);
+HANDLE CreateWaitableTimer(LPSECURITY_ATTRIBUTES sattrs, BOOL manualReset, LPCTSTR name);
+HANDLE CreateWaitableTimerEx(LPSECURITY_ATTRIBUTES sattrs, LPCTSTR name, DWORD flags, DWORD access);
+BOOL SetWaitableTimer(HANDLE timer, const LARGE_INTEGER* due, LONG period, PTIMERAPCROUTINE apc, LPVOID arg, BOOL resume);
+BOOL CancelWaitableTimer(HANDLE timer);
+PTP_WAIT CreateThreadpoolWait(PTP_WAIT_CALLBACK callback, PVOID context, PTP_CALLBACK_ENVIRON environment);
+VOID SetThreadpoolWait(PTP_WAIT wait, HANDLE handle, PFILETIME timeout);
+VOID WaitForThreadpoolWaitCallbacks(PTP_WAIT wait, BOOL cancelPending);
+VOID CloseThreadpoolWait(PTP_WAIT wait);
+
+#endif // SWAL_STANDIN_WINDOWS_H
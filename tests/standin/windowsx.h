@@ -0,0 +1,12 @@
+/*
+ * windowsx.h
+ *
+ * POSIX stand-in, see windows.h; nothing the tests use lives here
+ */
+
+#ifndef SWAL_STANDIN_WINDOWSX_H
+#define SWAL_STANDIN_WINDOWSX_H
+
+#include <windows.h>
+
+#endif // SWAL_STANDIN_WINDOWSX_H
@@ -0,0 +1,94 @@
+/*
+ * winioctl.h
+ *
+ * POSIX stand-in, see windows.h; only what handle.h and ioctl.h name is
+ * declared
+ */
+
+#ifndef SWAL_STANDIN_WINIOCTL_H
+#define SWAL_STANDIN_WINIOCTL_H
+
+#include <windows.h>
+
+#define FSCTL_SET_SPARSE 0x000900C4
+#define FSCTL_SET_ZERO_DATA 0x000980C8
+#define FSCTL_QUERY_ALLOCATED_RANGES 0x000940CF
+#define FSCTL_PIPE_LISTEN 0x00110008
+#define FSCTL_GET_NTFS_VOLUME_DATA 0x00090064
+#define IOCTL_DISK_GET_LENGTH_INFO 0x0007405C
+#define IOCTL_DISK_PERFORMANCE 0x00070020
+#define IOCTL_STORAGE_CHECK_VERIFY2 0x002D0800
+#define IOCTL_STORAGE_GET_DEVICE_NUMBER 0x002D1080
+
+typedef DWORD DEVICE_TYPE;
+
+typedef struct _FILE_SET_SPARSE_BUFFER {
+	BOOLEAN SetSparse;
+} FILE_SET_SPARSE_BUFFER;
+
+typedef struct _FILE_ZERO_DATA_INFORMATION {
+	LARGE_INTEGER FileOffset;
+	LARGE_INTEGER BeyondFinalZero;
+} FILE_ZERO_DATA_INFORMATION;
+
+typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
+	LARGE_INTEGER FileOffset;
+	LARGE_INTEGER Length;
+} FILE_ALLOCATED_RANGE_BUFFER;
+
+typedef struct _GET_LENGTH_INFORMATION {
+	LARGE_INTEGER Length;
+} GET_LENGTH_INFORMATION;
+
+typedef struct _DISK_PERFORMANCE {
+	LARGE_INTEGER BytesRead;
+	LARGE_INTEGER BytesWritten;
+	LARGE_INTEGER ReadTime;
+	LARGE_INTEGER WriteTime;
+	LARGE_INTEGER IdleTime;
+	DWORD ReadCount;
+	DWORD WriteCount;
+	DWORD QueueDepth;
+	DWORD SplitCount;
+	LARGE_INTEGER QueryTime;
+	DWORD StorageDeviceNumber;
+	WCHAR StorageManagerName[8];
+} DISK_PERFORMANCE;
+
+typedef struct _STORAGE_DEVICE_NUMBER {
+	DEVICE_TYPE DeviceType;
+	DWORD DeviceNumber;
+	DWORD PartitionNumber;
+} STORAGE_DEVICE_NUMBER;
+
+typedef struct _NTFS_VOLUME_DATA_BUFFER {
+	LARGE_INTEGER VolumeSerialNumber;
+	LARGE_INTEGER NumberSectors;
+	LARGE_INTEGER TotalClusters;
+	LARGE_INTEGER FreeClusters;
+	LARGE_INTEGER TotalReserved;
+	DWORD BytesPerSector;
+	DWORD BytesPerCluster;
+	DWORD BytesPerFileRecordSegment;
+	DWORD ClustersPerFileRecordSegment;
+	LARGE_INTEGER MftValidDataLength;
+	LARGE_INTEGER MftStartLcn;
+	LARGE_INTEGER Mft2StartLcn;
+	LARGE_INTEGER MftZoneStart;
+	LARGE_INTEGER MftZoneEnd;
+} NTFS_VOLUME_DATA_BUFFER;
+
+// Only FSCTL_PIPE_LISTEN on the server end of a named pipe is implemented;
+// other codes fail like a device that does not handle them
+inline BOOL DeviceIoControl(HANDLE device, DWORD code, LPVOID, DWORD, LPVOID, DWORD, LPDWORD, LPOVERLAPPED ovl) noexcept {
+	auto pipe = standin::Get<standin::Pipe>(device);
+	if (!pipe) {
+		return FALSE;
+	}
+	if (code != FSCTL_PIPE_LISTEN) {
+		return standin::FailWith(FALSE, ERROR_INVALID_FUNCTION);
+	}
+	return standin::Listen(*pipe, ovl);
+}
+
+#endif // SWAL_STANDIN_WINIOCTL_H
@@ -0,0 +1,584 @@
+/*
+ * winsock2.h
+ *
+ * POSIX stand-in for Winsock, including the Microsoft extension functions
+ * that live in mswsock.h on Windows. A SOCKET is a handle to a non-blocking
+ * socket descriptor; overlapped operations complete through the I/O
+ * completion ports in the windows.h stand-in. Only the stream socket calls
+ * the tests use are implemented: AcceptEx does not receive data with the
+ * connection, ConnectEx does not send any, and TransmitFile is not
+ * supported at all.
+ */
+
+#ifndef SWAL_STANDIN_WINSOCK2_H
+#define SWAL_STANDIN_WINSOCK2_H
+
+#include <windows.h>
+#include <memory>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+typedef UINT_PTR SOCKET;
+typedef unsigned int GROUP;
+typedef sa_family_t ADDRESS_FAMILY;
+typedef OVERLAPPED WSAOVERLAPPED;
+typedef OVERLAPPED* LPWSAOVERLAPPED;
+
+#define INVALID_SOCKET (~SOCKET(0))
+#define SOCKET_ERROR (-1)
+#define MAKEWORD(low, high) WORD(BYTE(low) | (WORD(BYTE(high)) << 8))
+#define SD_RECEIVE SHUT_RD
+#define SD_SEND SHUT_WR
+#define SD_BOTH SHUT_RDWR
+
+#define WSA_IO_INCOMPLETE ERROR_IO_INCOMPLETE
+#define WSA_IO_PENDING ERROR_IO_PENDING
+#define WSA_OPERATION_ABORTED ERROR_OPERATION_ABORTED
+#define WSAEFAULT 10014
+#define WSAEINVAL 10022
+#define WSAEMFILE 10024
+#define WSAEWOULDBLOCK 10035
+#define WSAENOTSOCK 10038
+#define WSAEOPNOTSUPP 10045
+#define WSAEAFNOSUPPORT 10047
+#define WSAEADDRINUSE 10048
+#define WSAEADDRNOTAVAIL 10049
+#define WSAENETUNREACH 10051
+#define WSAECONNABORTED 10053
+#define WSAECONNRESET 10054
+#define WSAENOBUFS 10055
+#define WSAEISCONN 10056
+#define WSAENOTCONN 10057
+#define WSAESHUTDOWN 10058
+#define WSAETIMEDOUT 10060
+#define WSAECONNREFUSED 10061
+#define WSAEHOSTUNREACH 10065
+
+#define WSA_FLAG_OVERLAPPED 0x01
+#define SO_PROTOCOL_INFO 0x2005
+#define SO_UPDATE_ACCEPT_CONTEXT 0x700B
+#define SO_UPDATE_CONNECT_CONTEXT 0x7010
+#define SIO_GET_EXTENSION_FUNCTION_POINTER 0xC8000006u
+
+#define XP1_CONNECTIONLESS 0x1
+#define XP1_GUARANTEED_DELIVERY 0x2
+#define XP1_GUARANTEED_ORDER 0x4
+#define XP1_GRACEFUL_CLOSE 0x20
+#define XP1_IFS_HANDLES 0x20000
+
+#define WSAID_ACCEPTEX { 0xb5367df1, 0xcbac, 0x11cf, { 0x95, 0xca, 0x00, 0x80, 0x5f, 0x48, 0xa1, 0x92 } }
+#define WSAID_GETACCEPTEXSOCKADDRS { 0xb5367df2, 0xcbac, 0x11cf, { 0x95, 0xca, 0x00, 0x80, 0x5f, 0x48, 0xa1, 0x92 } }
+#define WSAID_CONNECTEX { 0x25a207b9, 0xddf3, 0x4660, { 0x8e, 0xe9, 0x76, 0xe5, 0x8c, 0x74, 0x06, 0x3e } }
+#define WSAID_TRANSMITFILE { 0xb5367df0, 0xcbac, 0x11cf, { 0x95, 0xca, 0x00, 0x80, 0x5f, 0x48, 0xa1, 0x92 } }
+
+typedef struct WSAData {
+	WORD wVersion;
+	WORD wHighVersion;
+	char szDescription[257];
+	char szSystemStatus[129];
+} WSADATA, *LPWSADATA;
+
+typedef struct _WSABUF {
+	ULONG len;
+	CHAR* buf;
+} WSABUF, *LPWSABUF;
+
+typedef struct _WSAPROTOCOLCHAIN {
+	int ChainLen;
+	DWORD ChainEntries[7];
+} WSAPROTOCOLCHAIN;
+
+typedef struct _WSAPROTOCOL_INFOA {
+	DWORD dwServiceFlags1;
+	DWORD dwServiceFlags2;
+	DWORD dwServiceFlags3;
+	DWORD dwServiceFlags4;
+	DWORD dwProviderFlags;
+	GUID ProviderId;
+	DWORD dwCatalogEntryId;
+	WSAPROTOCOLCHAIN ProtocolChain;
+	int iVersion;
+	int iAddressFamily;
+	int iMaxSockAddr;
+	int iMinSockAddr;
+	int iSocketType;
+	int iProtocol;
+	int iProtocolMaxOffset;
+	int iNetworkByteOrder;
+	int iSecurityScheme;
+	DWORD dwMessageSize;
+	DWORD dwProviderReserved;
+	CHAR szProtocol[256];
+} WSAPROTOCOL_INFO, *LPWSAPROTOCOL_INFO;
+
+typedef struct _TRANSMIT_FILE_BUFFERS {
+	LPVOID Head;
+	DWORD HeadLength;
+	LPVOID Tail;
+	DWORD TailLength;
+} TRANSMIT_FILE_BUFFERS, *LPTRANSMIT_FILE_BUFFERS;
+
+typedef VOID (CALLBACK* LPWSAOVERLAPPED_COMPLETION_ROUTINE)(DWORD error, DWORD transferred, LPWSAOVERLAPPED ovl, DWORD flags);
+typedef BOOL (PASCAL* LPFN_ACCEPTEX)(SOCKET listener, SOCKET accepted, PVOID buffer, DWORD receiveSize,
+	DWORD localSize, DWORD remoteSize, LPDWORD received, LPOVERLAPPED ovl);
+typedef VOID (PASCAL* LPFN_GETACCEPTEXSOCKADDRS)(PVOID buffer, DWORD receiveSize, DWORD localSize, DWORD remoteSize,
+	sockaddr** local, LPINT localLength, sockaddr** remote, LPINT remoteLength);
+typedef BOOL (PASCAL* LPFN_CONNECTEX)(SOCKET sock, const sockaddr* name, int length, PVOID buffer, DWORD size,
+	LPDWORD sent, LPOVERLAPPED ovl);
+typedef BOOL (PASCAL* LPFN_TRANSMITFILE)(SOCKET sock, HANDLE file, DWORD length, DWORD sendSize, LPOVERLAPPED ovl,
+	LPTRANSMIT_FILE_BUFFERS buffers, DWORD flags);
+
+inline int WSAGetLastError() noexcept {
+	return int(GetLastError());
+}
+
+inline void WSASetLastError(int error) noexcept {
+	SetLastError(DWORD(error));
+}
+
+namespace standin {
+
+inline DWORD FromSocketErrno(int error) noexcept {
+	switch (error) {
+	case EAGAIN: return WSAEWOULDBLOCK;
+	case EBADF: case ENOTSOCK: return WSAENOTSOCK;
+	case EFAULT: return WSAEFAULT;
+	case EINVAL: return WSAEINVAL;
+	case EMFILE: case ENFILE: return WSAEMFILE;
+	case ENOBUFS: case ENOMEM: return WSAENOBUFS;
+	case EOPNOTSUPP: case EPROTONOSUPPORT: return WSAEOPNOTSUPP;
+	case EAFNOSUPPORT: return WSAEAFNOSUPPORT;
+	case EADDRINUSE: return WSAEADDRINUSE;
+	case EADDRNOTAVAIL: return WSAEADDRNOTAVAIL;
+	case ENETUNREACH: return WSAENETUNREACH;
+	case EHOSTUNREACH: return WSAEHOSTUNREACH;
+	case ECONNABORTED: return WSAECONNABORTED;
+	case ECONNRESET: case EPIPE: return WSAECONNRESET;
+	case EISCONN: return WSAEISCONN;
+	case ENOTCONN: return WSAENOTCONN;
+	case ETIMEDOUT: return WSAETIMEDOUT;
+	case ECONNREFUSED: return WSAECONNREFUSED;
+	default: return FromErrno(error);
+	}
+}
+
+inline bool WouldBlock(int error) noexcept {
+	return error == EAGAIN || error == EWOULDBLOCK;
+}
+
+struct Socket : IoObject {
+	int family = 0;
+	int type = 0;
+	int protocol = 0;
+	bool bound = false;
+};
+
+inline Socket* GetSocket(SOCKET sock) noexcept {
+	auto socket = Get<Socket>(reinterpret_cast<HANDLE>(sock));
+	if (!socket) {
+		SetLastError(WSAENOTSOCK);
+	}
+	return socket;
+}
+
+// Keeps a socket alive for an operation that refers to it
+inline std::shared_ptr<Socket> Hold(Socket* socket) {
+	AddRef(socket);
+	return std::shared_ptr<Socket>(socket, [](Socket* s) { Release(s); });
+}
+
+inline std::vector<iovec> ToIovec(LPWSABUF buffers, DWORD count) {
+	std::vector<iovec> result(count);
+	for (DWORD i = 0; i < count; ++i) {
+		result[i] = { buffers[i].buf, buffers[i].len };
+	}
+	return result;
+}
+
+// Returns 0 or SOCKET_ERROR from the result of IoObject::Start
+inline int Started(DWORD error) noexcept {
+	return error == ERROR_SUCCESS ? 0 : FailWith(SOCKET_ERROR, error);
+}
+
+// AcceptEx stores each address followed by its length in a slot of the
+// output buffer; on Windows the layout is private to the provider as well
+inline void StoreAddress(BYTE* slot, const sockaddr_storage& address, socklen_t length) noexcept {
+	int size = int(length);
+	std::memcpy(slot, &address, sizeof(address));
+	std::memcpy(slot + sizeof(address), &size, sizeof(size));
+}
+
+inline BOOL PASCAL AcceptEx(SOCKET listener, SOCKET accepted, PVOID buffer, DWORD receiveSize,
+	DWORD localSize, DWORD remoteSize, LPDWORD received, LPOVERLAPPED ovl)
+{
+	auto socket = GetSocket(listener);
+	auto target = GetSocket(accepted);
+	if (!socket || !target) {
+		return FALSE;
+	}
+	if (receiveSize != 0) {
+		return FailWith(FALSE, WSAEOPNOTSUPP);
+	}
+	constexpr DWORD slotSize = sizeof(sockaddr_storage) + sizeof(int);
+	if (localSize < slotSize || remoteSize < slotSize) {
+		return FailWith(FALSE, WSAEFAULT);
+	}
+	auto local = static_cast<BYTE*>(buffer);
+	auto remote = local + localSize;
+	auto attempt = [fd = socket->fd, target = Hold(target), local, remote](DWORD& error, DWORD& bytes) {
+		sockaddr_storage address;
+		socklen_t length = sizeof(address);
+		int client = accept4(fd, reinterpret_cast<sockaddr*>(&address), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client < 0) {
+			// a connection reset before it was accepted is skipped, like on Windows
+			if (WouldBlock(errno) || errno == ECONNABORTED) {
+				return false;
+			}
+			error = FromSocketErrno(errno);
+			return true;
+		}
+		StoreAddress(remote, address, length);
+		length = sizeof(address);
+		getsockname(client, reinterpret_cast<sockaddr*>(&address), &length);
+		StoreAddress(local, address, length);
+		// the accepted socket keeps its descriptor number
+		dup3(client, target->fd, O_CLOEXEC);
+		close(client);
+		bytes = 0;
+		return true;
+	};
+	return Started(socket->Start(ovl, POLLIN, attempt, received)) == 0;
+}
+
+inline VOID PASCAL GetAcceptExSockaddrs(PVOID buffer, DWORD receiveSize, DWORD localSize, DWORD,
+	sockaddr** local, LPINT localLength, sockaddr** remote, LPINT remoteLength)
+{
+	auto slot = static_cast<BYTE*>(buffer) + receiveSize;
+	*local = reinterpret_cast<sockaddr*>(slot);
+	std::memcpy(localLength, slot + sizeof(sockaddr_storage), sizeof(int));
+	slot += localSize;
+	*remote = reinterpret_cast<sockaddr*>(slot);
+	std::memcpy(remoteLength, slot + sizeof(sockaddr_storage), sizeof(int));
+}
+
+inline BOOL PASCAL ConnectEx(SOCKET sock, const sockaddr* name, int length, PVOID, DWORD size, LPDWORD sent, LPOVERLAPPED ovl) {
+	auto socket = GetSocket(sock);
+	if (!socket) {
+		return FALSE;
+	}
+	if (!socket->bound) {
+		return FailWith(FALSE, WSAEINVAL);
+	}
+	if (size != 0) {
+		return FailWith(FALSE, WSAEOPNOTSUPP);
+	}
+	if (connect(socket->fd, name, socklen_t(length)) != 0 && errno != EINPROGRESS) {
+		return FailWith(FALSE, FromSocketErrno(errno));
+	}
+	auto attempt = [fd = socket->fd](DWORD& error, DWORD& bytes) {
+		pollfd writable = { fd, POLLOUT, 0 };
+		if (poll(&writable, 1, 0) == 0) {
+			return false;
+		}
+		int result = 0;
+		socklen_t resultSize = sizeof(result);
+		getsockopt(fd, SOL_SOCKET, SO_ERROR, &result, &resultSize);
+		error = result == 0 ? ERROR_SUCCESS : FromSocketErrno(result);
+		bytes = 0;
+		return true;
+	};
+	return Started(socket->Start(ovl, POLLOUT, attempt, sent)) == 0;
+}
+
+inline BOOL PASCAL TransmitFile(SOCKET, HANDLE, DWORD, DWORD, LPOVERLAPPED, LPTRANSMIT_FILE_BUFFERS, DWORD) {
+	return FailWith(FALSE, WSAEOPNOTSUPP);
+}
+
+}
+
+inline int WSAStartup(WORD version, LPWSADATA data) noexcept {
+	*data = {};
+	data->wVersion = version;
+	data->wHighVersion = MAKEWORD(2, 2);
+	std::strcpy(data->szDescription, "swal stand-in");
+	return 0;
+}
+
+inline int WSACleanup() noexcept {
+	return 0;
+}
+
+inline SOCKET WSASocket(int af, int type, int protocol, LPWSAPROTOCOL_INFO, GROUP, DWORD) noexcept {
+	int fd = socket(af, type | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+	if (fd < 0) {
+		return standin::FailWith(INVALID_SOCKET, standin::FromSocketErrno(errno));
+	}
+	auto socket = new standin::Socket;
+	socket->fd = fd;
+	socket->family = af;
+	socket->type = type;
+	socket->protocol = protocol != 0 ? protocol : type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP;
+	return reinterpret_cast<SOCKET>(static_cast<standin::Object*>(socket));
+}
+
+// Cancels the pending operations and closes the connection at once; the
+// descriptor itself is closed when they have completed
+inline int closesocket(SOCKET sock) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	socket->Cancel(nullptr);
+	::shutdown(socket->fd, SHUT_RDWR);
+	standin::Release(socket);
+	return 0;
+}
+
+inline int bind(SOCKET sock, const sockaddr* address, int length) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (::bind(socket->fd, address, socklen_t(length)) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	socket->bound = true;
+	return 0;
+}
+
+inline int listen(SOCKET sock, int backlog) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (::listen(socket->fd, backlog) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	return 0;
+}
+
+inline int shutdown(SOCKET sock, int how) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (::shutdown(socket->fd, how) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	return 0;
+}
+
+inline int getsockname(SOCKET sock, sockaddr* address, int* length) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	auto size = socklen_t(*length);
+	if (::getsockname(socket->fd, address, &size) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	*length = int(size);
+	return 0;
+}
+
+inline int getpeername(SOCKET sock, sockaddr* address, int* length) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	auto size = socklen_t(*length);
+	if (::getpeername(socket->fd, address, &size) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	*length = int(size);
+	return 0;
+}
+
+// The update-context options have nothing to do on POSIX
+inline int setsockopt(SOCKET sock, int level, int name, const char* value, int length) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (level == SOL_SOCKET && (name == SO_UPDATE_ACCEPT_CONTEXT || name == SO_UPDATE_CONNECT_CONTEXT)) {
+		return 0;
+	}
+	if (::setsockopt(socket->fd, level, name, static_cast<const void*>(value), socklen_t(length)) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	return 0;
+}
+
+inline int getsockopt(SOCKET sock, int level, int name, char* value, int* length) noexcept {
+	auto socket = standin::GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (level == SOL_SOCKET && name == SO_PROTOCOL_INFO) {
+		if (*length < int(sizeof(WSAPROTOCOL_INFO))) {
+			return standin::FailWith(SOCKET_ERROR, WSAEFAULT);
+		}
+		WSAPROTOCOL_INFO info = {};
+		info.dwServiceFlags1 = XP1_IFS_HANDLES | (socket->type == SOCK_STREAM ?
+			XP1_GUARANTEED_DELIVERY | XP1_GUARANTEED_ORDER | XP1_GRACEFUL_CLOSE : XP1_CONNECTIONLESS);
+		info.iVersion = 2;
+		info.iAddressFamily = socket->family;
+		info.iMaxSockAddr = sizeof(sockaddr_storage);
+		info.iMinSockAddr = socket->family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+		info.iSocketType = socket->type;
+		info.iProtocol = socket->protocol;
+		std::strcpy(info.szProtocol, "swal stand-in");
+		std::memcpy(value, &info, sizeof(info));
+		*length = sizeof(info);
+		return 0;
+	}
+	auto size = socklen_t(*length);
+	if (::getsockopt(socket->fd, level, name, value, &size) != 0) {
+		return standin::FailWith(SOCKET_ERROR, standin::FromSocketErrno(errno));
+	}
+	*length = int(size);
+	return 0;
+}
+
+// Only looks up the extension functions
+inline int WSAIoctl(SOCKET sock, DWORD code, LPVOID in, DWORD inSize, LPVOID out, DWORD outSize, LPDWORD returned,
+	LPWSAOVERLAPPED, LPWSAOVERLAPPED_COMPLETION_ROUTINE) noexcept
+{
+	using namespace standin;
+	if (!GetSocket(sock)) {
+		return SOCKET_ERROR;
+	}
+	if (code != SIO_GET_EXTENSION_FUNCTION_POINTER) {
+		return FailWith(SOCKET_ERROR, WSAEOPNOTSUPP);
+	}
+	if (inSize != sizeof(GUID) || outSize < sizeof(void(*)())) {
+		return FailWith(SOCKET_ERROR, WSAEFAULT);
+	}
+	static const GUID acceptEx = WSAID_ACCEPTEX, getAcceptExSockaddrs = WSAID_GETACCEPTEXSOCKADDRS,
+		connectEx = WSAID_CONNECTEX, transmitFile = WSAID_TRANSMITFILE;
+	auto is = [in](const GUID& guid) { return std::memcmp(in, &guid, sizeof(guid)) == 0; };
+	auto put = [out, returned](auto function) {
+		std::memcpy(out, &function, sizeof(function));
+		*returned = sizeof(function);
+		return 0;
+	};
+	if (is(acceptEx)) {
+		return put(&AcceptEx);
+	}
+	if (is(getAcceptExSockaddrs)) {
+		return put(&GetAcceptExSockaddrs);
+	}
+	if (is(connectEx)) {
+		return put(&ConnectEx);
+	}
+	if (is(transmitFile)) {
+		return put(&TransmitFile);
+	}
+	return FailWith(SOCKET_ERROR, WSAEINVAL);
+}
+
+// Overlapped only; the flags are ignored
+inline int WSARecv(SOCKET sock, LPWSABUF buffers, DWORD count, LPDWORD received, LPDWORD flags, LPWSAOVERLAPPED ovl,
+	LPWSAOVERLAPPED_COMPLETION_ROUTINE) noexcept
+{
+	using namespace standin;
+	auto socket = GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (!ovl) {
+		return FailWith(SOCKET_ERROR, WSAEOPNOTSUPP);
+	}
+	*flags = 0;
+	auto attempt = [fd = socket->fd, iov = ToIovec(buffers, count)](DWORD& error, DWORD& bytes) mutable {
+		msghdr message = {};
+		message.msg_iov = iov.data();
+		message.msg_iovlen = iov.size();
+		auto result = recvmsg(fd, &message, MSG_DONTWAIT);
+		if (result < 0) {
+			if (WouldBlock(errno)) {
+				return false;
+			}
+			error = FromSocketErrno(errno);
+			return true;
+		}
+		bytes = DWORD(result);
+		return true;
+	};
+	return Started(socket->Start(ovl, POLLIN, attempt, received));
+}
+
+// Overlapped only; completes once all of the buffers have been sent
+inline int WSASend(SOCKET sock, LPWSABUF buffers, DWORD count, LPDWORD sent, DWORD, LPWSAOVERLAPPED ovl,
+	LPWSAOVERLAPPED_COMPLETION_ROUTINE) noexcept
+{
+	using namespace standin;
+	auto socket = GetSocket(sock);
+	if (!socket) {
+		return SOCKET_ERROR;
+	}
+	if (!ovl) {
+		return FailWith(SOCKET_ERROR, WSAEOPNOTSUPP);
+	}
+	auto attempt = [fd = socket->fd, iov = ToIovec(buffers, count), first = std::size_t(0), total = DWORD(0)]
+		(DWORD& error, DWORD& bytes) mutable
+	{
+		for (;;) {
+			while (first < iov.size() && iov[first].iov_len == 0) {
+				++first;
+			}
+			if (first == iov.size()) {
+				bytes = total;
+				return true;
+			}
+			msghdr message = {};
+			message.msg_iov = iov.data() + first;
+			message.msg_iovlen = iov.size() - first;
+			auto result = sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (result < 0) {
+				if (WouldBlock(errno)) {
+					return false;
+				}
+				error = FromSocketErrno(errno);
+				bytes = total;
+				return true;
+			}
+			total += DWORD(result);
+			for (auto left = std::size_t(result); left != 0; ++first) {
+				auto part = std::min(left, iov[first].iov_len);
+				iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + part;
+				iov[first].iov_len -= part;
+				left -= part;
+				if (iov[first].iov_len != 0) {
+					break;
+				}
+			}
+		}
+	};
+	return Started(socket->Start(ovl, POLLOUT, attempt, sent));
+}
+
+inline BOOL WSAGetOverlappedResult(SOCKET sock, LPWSAOVERLAPPED ovl, LPDWORD transferred, BOOL wait, LPDWORD flags) noexcept {
+	using namespace standin;
+	if (!GetSocket(sock)) {
+		return FALSE;
+	}
+	auto status = Status(*ovl).load(std::memory_order_acquire);
+	for (; status == Pending; status = Status(*ovl).load(std::memory_order_acquire)) {
+		if (!wait) {
+			return FailWith(FALSE, WSA_IO_INCOMPLETE);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	*transferred = DWORD(ovl->InternalHigh);
+	*flags = 0;
+	if (status != ERROR_SUCCESS) {
+		return FailWith(FALSE, DWORD(status));
+	}
+	return TRUE;
+}
+
+#endif // SWAL_STANDIN_WINSOCK2_H
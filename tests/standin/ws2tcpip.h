@@ -0,0 +1,12 @@
+/*
+ * ws2tcpip.h
+ *
+ * POSIX stand-in; the TCP/IP definitions come with winsock2.h.
+ */
+
+#ifndef SWAL_STANDIN_WS2TCPIP_H
+#define SWAL_STANDIN_WS2TCPIP_H
+
+#include <winsock2.h>
+
+#endif // SWAL_STANDIN_WS2TCPIP_H
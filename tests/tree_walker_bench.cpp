@@ -0,0 +1,37 @@
+// Walks a tree with 1, 2, 4, ... threads to show how the work-stealing
+// pool scales. Usage: tree_walker_bench [root] [max threads]
+#include <swal/tree_walker.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+	std::string root = argc > 1 ? argv[1] : "/usr";
+	unsigned maxThreads = argc > 2 ? unsigned(std::atoi(argv[2])) : std::max(1u, std::thread::hardware_concurrency());
+	std::wstring wideRoot = swal::multibyte_to_wide_char(CP_UTF8, root);
+	auto walk = [&](unsigned threads) {
+		std::atomic<ULONGLONG> bytes = 0;
+		swal::TreeWalker walker(threads);
+		auto start = std::chrono::steady_clock::now();
+		auto stats = walker.Walk(wideRoot, [&](const swal::TreeEntry& entry) {
+			bytes.fetch_add(entry.size, std::memory_order_relaxed);
+			return true;
+		});
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::printf("%7u %10zu %10zu %8zu %7zu %14llu %10.1f\n", threads, stats.directories, stats.entries,
+			stats.steals, stats.errors, static_cast<unsigned long long>(bytes.load()), elapsed.count());
+	};
+	std::printf("%7s %10s %10s %8s %7s %14s %10s\n", "threads", "dirs", "entries", "steals", "errors", "bytes", "ms");
+	// the first pass only warms the dentry and inode caches
+	walk(maxThreads);
+	for (unsigned threads = 1;; threads *= 2) {
+		walk(std::min(threads, maxThreads));
+		if (threads >= maxThreads) {
+			break;
+		}
+	}
+}
@@ -0,0 +1,139 @@
+#include <swal/tree_walker.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "check.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Files and directories created under the root, keyed by the path the
+// walker reports them under
+struct Tree {
+	fs::path root;
+	std::wstring rootName;
+	std::map<std::wstring, ULONGLONG> files;
+	std::map<std::wstring, bool> directories;
+	std::size_t opened = 1;
+	std::wstring Join(const std::wstring& parent, const std::wstring& name) const {
+		return parent + L'\\' + name;
+	}
+	void AddFile(const fs::path& dir, const std::wstring& parent, const std::wstring& name, const fs::path& file, std::size_t size) {
+		std::ofstream(dir / file, std::ios::binary) << std::string(size, 'x');
+		files.emplace(Join(parent, name), size);
+	}
+	// Builds depth levels of fanOut directories with files of different sizes
+	void AddLevel(const fs::path& dir, const std::wstring& parent, int depth, int fanOut) {
+		for (int i = 0; i < 5; ++i) {
+			auto name = L"f" + std::to_wstring(i) + L".bin";
+			AddFile(dir, parent, name, name, std::size_t(i) * 10);
+		}
+		if (depth == 0) {
+			return;
+		}
+		for (int i = 0; i < fanOut; ++i) {
+			auto name = L"d" + std::to_wstring(i);
+			fs::create_directory(dir / name);
+			directories.emplace(Join(parent, name), true);
+			++opened;
+			AddLevel(dir / name, Join(parent, name), depth - 1, fanOut);
+		}
+	}
+	Tree() {
+#ifdef _WIN32
+		auto process = GetCurrentProcessId();
+#else
+		auto process = getpid();
+#endif
+		root = fs::temp_directory_path() / ("swal-tree-" + std::to_string(process));
+		fs::remove_all(root);
+		fs::create_directory(root);
+		rootName = root.wstring();
+		AddLevel(root, rootName, 3, 3);
+		// more entries than fit into one query buffer
+		fs::create_directory(root / "big");
+		auto big = Join(rootName, L"big");
+		directories.emplace(big, true);
+		++opened;
+		for (int i = 0; i < 1500; ++i) {
+			auto name = L"entry-with-a-fairly-long-name-to-fill-the-buffer-" + std::to_wstring(i);
+			AddFile(root / "big", big, name, name, 1);
+		}
+		AddFile(root, rootName, L"ünïcode-名前", u8"ünïcode-名前", 7);
+		// reported but never descended into
+		fs::create_directory(root / "skip");
+		directories.emplace(Join(rootName, L"skip"), true);
+		std::ofstream(root / "skip" / "hidden") << "x";
+		fs::create_directory_symlink(root, root / "loop");
+		directories.emplace(Join(rootName, L"loop"), false);
+	}
+	~Tree() {
+		std::error_code ignored;
+		fs::remove_all(root, ignored);
+	}
+};
+
+void TestWalk(const Tree& tree, unsigned threads, DWORD bufferSize) {
+	std::mutex mutex;
+	std::map<std::wstring, ULONGLONG> files;
+	std::map<std::wstring, bool> directories;
+	swal::TreeWalker walker(threads, bufferSize);
+	auto stats = walker.Walk(tree.rootName, [&](const swal::TreeEntry& entry) {
+		CHECK(entry.fileId.QuadPart != 0);
+		auto path = tree.Join(std::wstring(entry.directory), std::wstring(entry.name));
+		std::lock_guard lock(mutex);
+		if (entry.IsDirectory()) {
+			CHECK(directories.emplace(path, !entry.IsReparsePoint()).second);
+			return entry.name != L"skip";
+		}
+		CHECK(files.emplace(path, entry.size).second);
+		return true;
+	});
+	CHECK(files == tree.files);
+	CHECK(directories == tree.directories);
+	CHECK(stats.directories == tree.opened);
+	CHECK(stats.entries == tree.files.size() + tree.directories.size());
+	CHECK(stats.errors == 0);
+}
+
+void TestErrors(const Tree& tree) {
+	swal::TreeWalker walker(4);
+	auto stats = walker.Walk(tree.Join(tree.rootName, L"missing"), [](const swal::TreeEntry&) { return true; });
+	CHECK(stats.directories == 0 && stats.entries == 0 && stats.errors == 1);
+	// a buffer too small for a single record fails the query
+	swal::TreeWalker tiny(1, 64);
+	stats = tiny.Walk(tree.Join(tree.rootName, L"big"), [](const swal::TreeEntry&) { return true; });
+	CHECK(stats.directories == 1 && stats.entries == 0 && stats.errors == 1);
+	std::atomic<int> calls = 0;
+	try {
+		walker.Walk(tree.rootName, [&](const swal::TreeEntry& entry) {
+			++calls;
+			if (entry.name == L"f3.bin") {
+				throw std::runtime_error("stop");
+			}
+			return true;
+		});
+		CHECK(!"the exception was not rethrown");
+	} catch (const std::runtime_error&) {
+	}
+	CHECK(calls > 0);
+}
+
+}
+
+int main() {
+	Tree tree;
+	TestWalk(tree, 1, 64 * 1024);
+	TestWalk(tree, 4, 4096);
+	TestWalk(tree, 16, 1024);
+	TestErrors(tree);
+}
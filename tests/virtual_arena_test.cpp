@@ -0,0 +1,184 @@
+#include <swal/virtual_arena.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <vector>
+#include "check.h"
+
+namespace {
+
+constexpr SIZE_T MiB = 1024 * 1024;
+
+MEMORY_BASIC_INFORMATION Query(const void* address) {
+	MEMORY_BASIC_INFORMATION info;
+	CHECK(VirtualQuery(address, &info, sizeof(info)) == sizeof(info));
+	return info;
+}
+
+bool IsAligned(const void* p, std::size_t alignment) {
+	return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+void TestGrowth() {
+	swal::VirtualArena arena(64 * MiB, false, NUMA_NO_PREFERRED_NODE, MiB);
+	auto base = static_cast<std::byte*>(arena.Data());
+	CHECK(arena.Capacity() == 64 * MiB);
+	CHECK(arena.Committed() == 0 && arena.Used() == 0 && !arena.LargePages());
+	CHECK(Query(base).State == MEM_RESERVE);
+	auto small = arena.Allocate(100);
+	CHECK(small == base);
+	CHECK(arena.Used() == 100 && arena.Committed() == MiB);
+	auto committed = Query(base);
+	CHECK(committed.State == MEM_COMMIT && committed.RegionSize == MiB);
+	auto reserved = Query(base + MiB);
+	CHECK(reserved.State == MEM_RESERVE && reserved.RegionSize == 63 * MiB);
+	// commits whole steps past the end of the allocation
+	auto large = static_cast<std::byte*>(arena.Allocate(3 * MiB));
+	CHECK(IsAligned(large, alignof(std::max_align_t)) && large >= base + 100);
+	CHECK(arena.Committed() == 4 * MiB);
+	std::memset(small, 1, 100);
+	std::memset(large, 2, 3 * MiB);
+	CHECK(Query(base + 4 * MiB - 1).State == MEM_COMMIT);
+	CHECK(Query(base + 4 * MiB).State == MEM_RESERVE);
+}
+
+void TestAlignment() {
+	swal::VirtualArena arena(4 * MiB, false, NUMA_NO_PREFERRED_NODE, 64 * 1024);
+	for (std::size_t alignment : { 1, 2, 8, 16, 64, 4096, 65536 }) {
+		arena.Allocate(3, 1);
+		auto p = arena.Allocate(3, alignment);
+		CHECK(IsAligned(p, alignment));
+		std::memset(p, 0xFF, 3);
+	}
+	// an alignment larger than the commit step still commits enough
+	auto p = static_cast<std::byte*>(arena.Allocate(16, MiB));
+	CHECK(IsAligned(p, MiB));
+	CHECK(static_cast<SIZE_T>(p + 16 - static_cast<std::byte*>(arena.Data())) <= arena.Committed());
+	std::memset(p, 0xFF, 16);
+}
+
+void TestExhaustion() {
+	swal::VirtualArena arena(MiB, false, NUMA_NO_PREFERRED_NODE, 256 * 1024);
+	arena.Allocate(10, 1);
+	bool thrown = false;
+	try {
+		arena.Allocate(MiB, 1);
+	} catch (const std::bad_alloc&) {
+		thrown = true;
+	}
+	CHECK(thrown && arena.Used() == 10);
+	auto rest = arena.Allocate(MiB - 10, 1);
+	std::memset(rest, 3, MiB - 10);
+	CHECK(arena.Used() == MiB && arena.Committed() == MiB);
+	thrown = false;
+	try {
+		arena.Allocate(1, 1);
+	} catch (const std::bad_alloc&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+void TestResetAndTrim() {
+	swal::VirtualArena arena(16 * MiB, false, NUMA_NO_PREFERRED_NODE, MiB);
+	auto base = static_cast<std::byte*>(arena.Data());
+	std::memset(arena.Allocate(3 * MiB, 1), 0x5A, 3 * MiB);
+	CHECK(arena.Committed() == 3 * MiB);
+	arena.Reset();
+	CHECK(arena.Used() == 0 && arena.Committed() == 3 * MiB);
+	// Trim keeps what is in use even when asked for less
+	arena.Allocate(MiB + 1, 1);
+	arena.Trim();
+	SYSTEM_INFO system;
+	GetSystemInfo(&system);
+	CHECK(arena.Committed() == MiB + system.dwPageSize);
+	arena.Reset();
+	arena.Trim(MiB);
+	CHECK(arena.Committed() == MiB);
+	CHECK(Query(base + MiB).State == MEM_RESERVE);
+	// committed pages keep their contents, decommitted ones come back zeroed
+	auto again = static_cast<std::byte*>(arena.Allocate(3 * MiB, 1));
+	CHECK(again == base);
+	CHECK(again[0] == std::byte(0x5A) && again[MiB - 1] == std::byte(0x5A));
+	CHECK(again[MiB] == std::byte(0) && again[3 * MiB - 1] == std::byte(0));
+	arena.Reset();
+	arena.Trim();
+	CHECK(arena.Committed() == 0);
+	CHECK(Query(base).State == MEM_RESERVE);
+}
+
+void TestMemoryResource() {
+	swal::VirtualArena arena(64 * MiB);
+	swal::VirtualArenaResource resource(arena);
+	CHECK(&resource.Arena() == &arena);
+	{
+		std::pmr::vector<int> values(&resource);
+		for (int i = 0; i < 100000; ++i) {
+			values.push_back(i);
+		}
+		for (int i = 0; i < 100000; ++i) {
+			CHECK(values[std::size_t(i)] == i);
+		}
+		std::pmr::vector<std::pmr::vector<double>> nested(&resource);
+		nested.emplace_back(1000, 1.5);
+		CHECK(nested.back().get_allocator().resource() == &resource);
+	}
+	CHECK(arena.Used() >= 100000 * sizeof(int));
+	CHECK(resource.is_equal(resource));
+	swal::VirtualArenaResource other(arena);
+	CHECK(!resource.is_equal(other));
+	arena.Reset();
+	CHECK(resource.allocate(64, 64) == arena.Data());
+}
+
+void TestLargePages() {
+	auto check = [](swal::VirtualArena& arena, SIZE_T reserve) {
+		if (arena.LargePages()) {
+			auto largePage = GetLargePageMinimum();
+			CHECK(arena.Capacity() % largePage == 0 && arena.Capacity() >= reserve);
+			CHECK(arena.Committed() == arena.Capacity());
+			arena.Trim();
+			CHECK(arena.Committed() == arena.Capacity());
+		} else {
+			CHECK(arena.Committed() == 0);
+		}
+		std::memset(arena.Allocate(reserve, 1), 7, reserve);
+	};
+	// uses large pages where the account and the system allow it
+	swal::VirtualArena arena(3 * MiB, true);
+	check(arena, 3 * MiB);
+#ifndef _WIN32
+	// without the privilege the arena falls back to normal pages
+	standin::lockMemoryGranted = false;
+	swal::VirtualArena fallback(3 * MiB, true);
+	CHECK(!fallback.LargePages() && fallback.Capacity() == 3 * MiB);
+	check(fallback, 3 * MiB);
+	standin::lockMemoryGranted = true;
+#endif
+}
+
+void TestNumaAndRelease() {
+	void* base;
+	{
+		swal::VirtualArena arena(8 * MiB, false, 0);
+		base = arena.Data();
+		std::memset(arena.Allocate(2 * MiB), 9, 2 * MiB);
+		CHECK(arena.Committed() == 2 * MiB);
+	}
+	MEMORY_BASIC_INFORMATION info;
+	CHECK(VirtualQuery(base, &info, sizeof(info)) == 0 || info.State == MEM_FREE);
+}
+
+}
+
+int main() {
+	TestGrowth();
+	TestAlignment();
+	TestExhaustion();
+	TestResetAndTrim();
+	TestMemoryResource();
+	TestLargePages();
+	TestNumaAndRelease();
+}